@@ -0,0 +1,27 @@
+#include "admission.h"
+
+void initAdmission(Admission* admission, int limit) {
+    admission->limit = limit > 0 ? limit : 0;
+    admission->count = 0;
+}
+
+bool tryAdmit(Admission* admission) {
+    if (admission->limit == 0) {
+        __atomic_add_fetch(&admission->count, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+    int count = __atomic_load_n(&admission->count, __ATOMIC_RELAXED);
+    do {
+        if (count >= admission->limit) return false;
+    } while (!__atomic_compare_exchange_n(&admission->count, &count, count + 1, true,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    return true;
+}
+
+void releaseAdmission(Admission* admission) {
+    __atomic_sub_fetch(&admission->count, 1, __ATOMIC_RELEASE);
+}
+
+int getAdmitted(Admission* admission) {
+    return __atomic_load_n(&admission->count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,30 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdbool.h>
+
+// Admission control. An Admission counts what it let in against a limit;
+// servers answer what doesn't fit with BUSY_REPLY at once instead of queueing
+// it, so the requests they do take keep their latency under overload.
+
+#define BUSY_REPLY "Busy\n"
+#define BUSY_REPLY_LEN (sizeof(BUSY_REPLY) - 1)   // without the NUL, on every server
+
+typedef struct {
+    int limit;   // 0 admits everything
+    int count;
+} Admission;
+
+// Sets the limit, 0 for none
+void initAdmission(Admission* admission, int limit);
+
+// Takes a slot, returns false without waiting if the limit is reached
+bool tryAdmit(Admission* admission);
+
+// Gives back a slot taken by tryAdmit
+void releaseAdmission(Admission* admission);
+
+// Returns the slots taken
+int getAdmitted(Admission* admission);
+
+#endif
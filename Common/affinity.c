@@ -0,0 +1,119 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "affinity.h"
+
+#define MAX_CPUS 1024
+#define MAX_NODES 1024
+
+// From linux/mempolicy.h, which not every libc installs
+#define MPOL_INTERLEAVE 3
+#define MPOL_LOCAL 4
+#define MPOL_MF_MOVE (1 << 1)
+
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+static bool interleave = false;
+static int node_count = 0;
+static unsigned long node_mask[MAX_NODES / (8 * sizeof(unsigned long))];
+
+// Parses a list such as "0-3,8" into ids, returns how many it holds or -1
+static int parse_list(const char* list, int* ids, int max) {
+    int count = 0;
+    const char* p = list;
+    while (*p && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return -1;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return -1;
+        }
+        for (long id = first; id <= last && count < max; id++) ids[count++] = (int)id;
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return -1;
+    }
+    return count;
+}
+
+static void init_numa(void) {
+    const char* value = getenv("GRAPH_INTERLEAVE");
+    interleave = value && *value && strcmp(value, "0") != 0;
+
+    char list[256];
+    FILE* f = fopen("/sys/devices/system/node/online", "r");
+    if (!f) return;
+    if (fgets(list, sizeof(list), f)) {
+        static int nodes[MAX_NODES];
+        int count = parse_list(list, nodes, MAX_NODES);
+        for (int i = 0; i < count; i++) {
+            node_mask[nodes[i] / (8 * sizeof(unsigned long))] |= 1UL << (nodes[i] % (8 * sizeof(unsigned long)));
+        }
+        node_count = count > 0 ? count : 0;
+    }
+    fclose(f);
+}
+
+int pinThread(const char* var, int index) {
+    const char* list = getenv(var);
+    if (!list || !*list) return 0;
+
+    int cpus[MAX_CPUS];
+    int count = parse_list(list, cpus, MAX_CPUS);
+    if (count <= 0) {
+        fprintf(stderr, "%s: bad CPU list \"%s\"\n", var, list);
+        return -1;
+    }
+    int cpu = cpus[index % count];
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0) return 0;
+#endif
+    fprintf(stderr, "%s: can't pin to CPU %d\n", var, cpu);
+    return -1;
+}
+
+bool interleaveEnabled(void) {
+    pthread_once(&numa_once, init_numa);
+    return interleave;
+}
+
+// mbind works on whole pages, so the range shrinks to the pages inside it
+static void set_policy(void* addr, size_t len, int mode, const unsigned long* mask, unsigned long max_node) {
+    pthread_once(&numa_once, init_numa);
+    if (node_count < 2) return;
+#ifdef __linux__
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)addr + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t)addr + len) & ~(page - 1);
+    if (end <= start) return;
+    // Only a hint, on failure the pages stay where the kernel put them
+    syscall(SYS_mbind, start, end - start, mode, mask, max_node, MPOL_MF_MOVE);
+#else
+    (void)addr;
+    (void)len;
+    (void)mode;
+    (void)mask;
+    (void)max_node;
+#endif
+}
+
+void interleaveMemory(void* addr, size_t len) {
+    set_policy(addr, len, MPOL_INTERLEAVE, node_mask, MAX_NODES);
+}
+
+void localizeMemory(void* addr, size_t len) {
+    set_policy(addr, len, MPOL_LOCAL, NULL, 0);
+}
@@ -0,0 +1,30 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Thread placement and NUMA memory policy, configured from the environment.
+// Everything here does nothing when its variable is unset, and the memory
+// calls do nothing on a machine with a single NUMA node.
+
+// Environment variables holding CPU lists such as "0-3,8"
+#define ACCEPT_CPUS "ACCEPT_CPUS"
+#define WORKER_CPUS "WORKER_CPUS"
+#define CONSUMER_CPUS "CONSUMER_CPUS"
+
+// Pins the calling thread to the index-th CPU, round robin, of the list in
+// the environment variable var. Returns 0 when pinned or when var is unset.
+int pinThread(const char* var, int index);
+
+// True when GRAPH_INTERLEAVE is set to something other than 0
+bool interleaveEnabled(void);
+
+// Spreads the pages of [addr, addr + len) over every NUMA node
+void interleaveMemory(void* addr, size_t len);
+
+// Moves the pages of [addr, addr + len) to the calling thread's node and
+// keeps new ones there. Partial pages at either end are left alone.
+void localizeMemory(void* addr, size_t len);
+
+#endif
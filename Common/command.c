@@ -0,0 +1,370 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "command.h"
+
+// Bulk buffer of readPoints
+#define POINT_READ_SIZE 65536
+
+// The shortest point line, "x,y\n"
+#define MIN_POINT_LINE 4
+
+// Points readPoints allocates before any arrive, it doubles from there
+#define POINTS_INITIAL 4096
+
+// The points of a Newgraph read so far. The array grows with the lines that
+// actually arrive, not with the count the client claimed.
+typedef struct {
+    Point* points;
+    int capacity;
+    int count;    // lines taken, including any after the graph was rejected
+    int n;
+    int result;   // POINTS_OK until a line rejects the graph
+} PointBuffer;
+
+// Exact powers of ten representable in a double
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static size_t skip_spaces(const char* s, size_t i, size_t len) {
+    while (i < len && is_space(s[i])) i++;
+    return i;
+}
+
+size_t parseFloat(const char* s, size_t len, Coord* out) {
+    size_t i = 0;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+
+    if (i < len && (s[i] == '+' || s[i] == '-')) {
+        negative = s[i] == '-';
+        i++;
+    }
+
+    // Digits past the 19th no longer fit the mantissa, they only scale it
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+        if (mantissa < 1000000000000000000ull) mantissa = mantissa * 10 + (s[i] - '0');
+        else exponent++;
+    }
+    if (i < len && s[i] == '.') {
+        for (i++; i < len && s[i] >= '0' && s[i] <= '9'; i++, digits++) {
+            if (mantissa < 1000000000000000000ull) {
+                mantissa = mantissa * 10 + (s[i] - '0');
+                exponent--;
+            }
+        }
+    }
+    if (digits == 0) return 0;
+
+    if (i < len && (s[i] == 'e' || s[i] == 'E')) {
+        size_t j = i + 1;
+        bool exp_negative = false;
+        int exp_value = 0;
+        if (j < len && (s[j] == '+' || s[j] == '-')) {
+            exp_negative = s[j] == '-';
+            j++;
+        }
+        if (j < len && s[j] >= '0' && s[j] <= '9') {
+            for (; j < len && s[j] >= '0' && s[j] <= '9'; j++) {
+                if (exp_value < 10000) exp_value = exp_value * 10 + (s[j] - '0');
+            }
+            exponent += exp_negative ? -exp_value : exp_value;
+            i = j;
+        }
+    }
+
+    double value = (double)mantissa;
+    while (exponent > 22) {
+        value *= 1e22;
+        exponent -= 22;
+    }
+    while (exponent < -22) {
+        value /= 1e22;
+        exponent += 22;
+    }
+    value = exponent >= 0 ? value * powers_of_ten[exponent] : value / powers_of_ten[-exponent];
+
+    *out = (Coord)(negative ? -value : value);
+    return i;
+}
+
+bool parsePoint(const char* s, size_t len, Coord* x, Coord* y) {
+    size_t i = skip_spaces(s, 0, len);
+    size_t used = parseFloat(s + i, len - i, x);
+    if (used == 0) return false;
+    i = skip_spaces(s, i + used, len);
+    if (i >= len || s[i] != ',') return false;
+    i = skip_spaces(s, i + 1, len);
+    used = parseFloat(s + i, len - i, y);
+    if (used == 0) return false;
+    return skip_spaces(s, i + used, len) == len;
+}
+
+static bool parse_count(const char* s, size_t len, int* n) {
+    size_t i = skip_spaces(s, 0, len);
+    long value = 0;
+    size_t first = i;
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+        value = value * 10 + (s[i] - '0');
+        if (value > INT_MAX) return false;
+    }
+    if (i == first || skip_spaces(s, i, len) != len) return false;
+    *n = (int)value;
+    return true;
+}
+
+static bool parse_name(const char* s, size_t len, char* name) {
+    size_t i = skip_spaces(s, 0, len);
+    size_t first = i;
+    while (i < len && !is_space(s[i])) i++;
+    size_t name_len = i - first;
+    if (name_len == 0 || name_len >= GRAPH_NAME_MAX || skip_spaces(s, i, len) != len) return false;
+    memcpy(name, s + first, name_len);
+    name[name_len] = '\0';
+    return isValidGraphName(name);
+}
+
+// Maps the verb to a command by its length and a distinguishing byte,
+// then confirms the whole word so prefixes like "CHX" don't match
+static CommandType lookup_verb(const char* verb, size_t len) {
+    switch (len) {
+    case 2:
+        if (verb[0] == 'C' && verb[1] == 'H') return CMD_CH;
+        break;
+    case 3:
+        if (memcmp(verb, "Use", 3) == 0) return CMD_USE;
+        break;
+    case 5:
+        if (memcmp(verb, "Stats", 5) == 0) return CMD_STATS;
+        break;
+    case 8:
+        if (verb[3] == 'g' && memcmp(verb, "Newgraph", 8) == 0) return CMD_NEWGRAPH;
+        if (verb[3] == 'p' && memcmp(verb, "Newpoint", 8) == 0) return CMD_NEWPOINT;
+        break;
+    case 11:
+        if (memcmp(verb, "Removepoint", 11) == 0) return CMD_REMOVEPOINT;
+        break;
+    }
+    return CMD_UNKNOWN;
+}
+
+void parseCommand(const char* line, size_t len, Command* cmd) {
+    size_t start = skip_spaces(line, 0, len);
+    size_t end = start;
+    while (end < len && !is_space(line[end])) end++;
+
+    cmd->type = lookup_verb(line + start, end - start);
+    cmd->valid = false;
+
+    const char* args = line + end;
+    size_t args_len = len - end;
+
+    switch (cmd->type) {
+    case CMD_NEWGRAPH:
+        cmd->valid = parse_count(args, args_len, &cmd->n) && cmd->n > 0;
+        break;
+    case CMD_NEWPOINT:
+    case CMD_REMOVEPOINT:
+        cmd->valid = parsePoint(args, args_len, &cmd->x, &cmd->y);
+        break;
+    case CMD_CH:
+    case CMD_STATS:
+        // CH and Stats take no arguments, anything after them makes a different word
+        cmd->valid = skip_spaces(args, 0, args_len) == args_len;
+        if (!cmd->valid) cmd->type = CMD_UNKNOWN;
+        break;
+    case CMD_USE:
+        cmd->valid = parse_name(args, args_len, cmd->name);
+        break;
+    case CMD_UNKNOWN:
+        break;
+    }
+}
+
+void initLineReader(LineReader* reader) {
+    reader->start = 0;
+    reader->end = 0;
+}
+
+char* nextLine(LineReader* reader, size_t* len) {
+    char* line = reader->buf + reader->start;
+    char* nl = memchr(line, '\n', reader->end - reader->start);
+
+    if (!nl) {
+        // A line that fills the whole buffer is handed out as is
+        if (reader->start > 0 || reader->end < LINE_BUFFER_SIZE - 1) return NULL;
+        nl = reader->buf + reader->end;
+    }
+
+    *len = nl - line;
+    if (*len > 0 && line[*len - 1] == '\r') (*len)--;
+    line[*len] = '\0';
+    reader->start = (nl - reader->buf) + (nl < reader->buf + reader->end ? 1 : 0);
+    // The returned line stays valid until the next fill
+    if (reader->start == reader->end) {
+        reader->start = 0;
+        reader->end = 0;
+    }
+    return line;
+}
+
+// Slides the unread bytes to the front, making room at the end
+static void compact(LineReader* reader) {
+    if (reader->start > 0) {
+        memmove(reader->buf, reader->buf + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+}
+
+int fillLineReader(LineReader* reader, int fd) {
+    compact(reader);
+    int n = recv(fd, reader->buf + reader->end, LINE_BUFFER_SIZE - 1 - reader->end, 0);
+    if (n > 0) reader->end += n;
+    return n;
+}
+
+size_t feedLineReader(LineReader* reader, const char* data, size_t len) {
+    compact(reader);
+    size_t room = LINE_BUFFER_SIZE - 1 - reader->end;
+    if (len > room) len = room;
+    memcpy(reader->buf + reader->end, data, len);
+    reader->end += len;
+    return len;
+}
+
+char* readLine(LineReader* reader, int fd, size_t* len) {
+    char* line;
+    while ((line = nextLine(reader, len)) == NULL) {
+        if (fillLineReader(reader, fd) <= 0) return NULL;
+    }
+    return line;
+}
+
+// Puts bytes read past a Newgraph back into an emptied reader
+static void push_back(LineReader* reader, const char* bytes, size_t len) {
+    memcpy(reader->buf, bytes, len);
+    reader->end = len;
+}
+
+// Drops the points, the remaining lines are only counted
+static void reject_points(PointBuffer* buffer, int result) {
+    free(buffer->points);
+    buffer->points = NULL;
+    buffer->result = result;
+}
+
+// Counts a line that is too long to be a point
+static void skip_point(PointBuffer* buffer) {
+    buffer->count++;
+    if (buffer->result == POINTS_OK) reject_points(buffer, POINTS_INVALID);
+}
+
+// Parses the next point line into the buffer, growing it when it is full
+static void take_point(PointBuffer* buffer, const char* line, size_t len) {
+    int index = buffer->count++;
+    if (buffer->result != POINTS_OK) return;
+
+    if (index == buffer->capacity) {
+        int capacity = buffer->capacity > buffer->n / 2 ? buffer->n : buffer->capacity * 2;
+        Point* grown = realloc(buffer->points, (size_t)capacity * sizeof(Point));
+        if (!grown) {
+            reject_points(buffer, POINTS_NO_MEMORY);
+            return;
+        }
+        buffer->points = grown;
+        buffer->capacity = capacity;
+    }
+    Point* point = &buffer->points[index];
+    if (!parsePoint(line, len, &point->x, &point->y)) reject_points(buffer, POINTS_INVALID);
+}
+
+int readPoints(LineReader* reader, int fd, int n, Point** points) {
+    PointBuffer buffer;
+    size_t len;
+    char* line;
+
+    buffer.capacity = n < POINTS_INITIAL ? n : POINTS_INITIAL;
+    buffer.points = malloc((size_t)buffer.capacity * sizeof(Point));
+    buffer.count = 0;
+    buffer.n = n;
+    buffer.result = POINTS_OK;
+    if (!buffer.points) reject_points(&buffer, POINTS_NO_MEMORY);
+    *points = NULL;
+
+    // Lines the reader already holds come first
+    while (buffer.count < n && (line = nextLine(reader, &len)) != NULL) {
+        take_point(&buffer, line, len);
+    }
+    if (buffer.count == n) {
+        *points = buffer.points;
+        return buffer.result;
+    }
+
+    // Then its partial line starts the bulk buffer
+    char buf[POINT_READ_SIZE];
+    size_t used = reader->end - reader->start;
+    memcpy(buf, reader->buf + reader->start, used);
+    initLineReader(reader);
+    bool skipping = false;   // inside a line longer than the buffer
+
+    size_t end = used;
+    size_t start = 0;
+    while (buffer.count < n) {
+        // Every missing point takes MIN_POINT_LINE bytes and a started line at
+        // least one more, so a read of well formed points never reaches the
+        // commands that follow
+        size_t partial = skipping ? MIN_POINT_LINE - 1 : (used < MIN_POINT_LINE - 1 ? used : MIN_POINT_LINE - 1);
+        size_t needed = (size_t)(n - buffer.count) * MIN_POINT_LINE - partial;
+        // Shorter malformed lines can still take it past them, but every line
+        // takes at least its newline, so what's read past the last one fits the reader
+        size_t spill = (size_t)(n - buffer.count) + LINE_BUFFER_SIZE - 1;
+        if (spill < needed) needed = spill;
+        size_t room = POINT_READ_SIZE - used;
+        ssize_t got = recv(fd, buf + used, needed < room ? needed : room, 0);
+        if (got <= 0) {
+            free(buffer.points);
+            return -1;
+        }
+
+        end = used + (size_t)got;
+        start = 0;
+        char* nl;
+        while (buffer.count < n && (nl = memchr(buf + start, '\n', end - start)) != NULL) {
+            size_t line_len = (size_t)(nl - (buf + start));
+            if (skipping) {
+                skipping = false;
+                skip_point(&buffer);
+            } else {
+                take_point(&buffer, buf + start, line_len);
+            }
+            start += line_len + 1;
+        }
+
+        if (buffer.count == n) break;
+        used = end - start;
+        memmove(buf, buf + start, used);
+        if (used == POINT_READ_SIZE) {
+            // No point is that long, drop it and count it once its newline shows up
+            skipping = true;
+            used = 0;
+        }
+    }
+
+    // Commands read along with the last points go back to the reader
+    push_back(reader, buf + start, end - start);
+    *points = buffer.points;
+    return buffer.result;
+}
@@ -0,0 +1,75 @@
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "graph.h"
+
+#define LINE_BUFFER_SIZE 4096
+
+typedef enum {
+    CMD_UNKNOWN,
+    CMD_NEWGRAPH,
+    CMD_NEWPOINT,
+    CMD_REMOVEPOINT,
+    CMD_CH,
+    CMD_USE,
+    CMD_STATS
+} CommandType;
+
+// A parsed command line, valid is false when the verb matched but the arguments didn't
+typedef struct {
+    CommandType type;
+    bool valid;
+    int n;
+    Coord x;
+    Coord y;
+    char name[GRAPH_NAME_MAX];
+} Command;
+
+// Buffers socket input and splits it into newline terminated lines
+typedef struct {
+    char buf[LINE_BUFFER_SIZE];
+    size_t start;
+    size_t end;
+} LineReader;
+
+// Parses one command line (without its newline)
+void parseCommand(const char* line, size_t len, Command* cmd);
+
+// Parses "x,y", rejects anything but surrounding whitespace
+bool parsePoint(const char* s, size_t len, Coord* x, Coord* y);
+
+// Locale independent number parser, returns the number of characters consumed (0 on error)
+size_t parseFloat(const char* s, size_t len, Coord* out);
+
+// Resets the reader to an empty buffer
+void initLineReader(LineReader* reader);
+
+// Returns the next buffered line with the newline stripped, or NULL if none is complete
+char* nextLine(LineReader* reader, size_t* len);
+
+// Reads once from fd into the buffer, returns what recv returned
+int fillLineReader(LineReader* reader, int fd);
+
+// Copies as much of data as fits into the buffer, for input received
+// elsewhere; returns how many bytes it took
+size_t feedLineReader(LineReader* reader, const char* data, size_t len);
+
+// Returns the next line, blocking on fd until one is complete; NULL on EOF or error
+char* readLine(LineReader* reader, int fd, size_t* len);
+
+// Results of readPoints besides -1 for a disconnected client
+#define POINTS_OK 0          // *points holds the n points, the caller frees them
+#define POINTS_INVALID 1     // a line wasn't a point
+#define POINTS_NO_MEMORY 2   // the points didn't fit in memory
+
+// Reads the n "x,y" lines of a Newgraph into a new array stored in *points,
+// parsing straight out of large reads. The array grows with the lines that
+// arrive, so a client can't make it allocate n points up front. Bytes read
+// past the last point line are left in the reader. Every one of the n lines
+// is consumed even once the graph is rejected; *points is NULL unless
+// POINTS_OK is returned.
+int readPoints(LineReader* reader, int fd, int n, Point** points);
+
+#endif
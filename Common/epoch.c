@@ -0,0 +1,144 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "epoch.h"
+
+// One per thread that ever read. Records are never freed, a thread that
+// exits leaves its record for the next new thread to claim.
+typedef struct EpochRecord {
+    uint64_t state;   // 0 outside a read section, epoch << 1 | 1 inside
+    int in_use;
+    struct EpochRecord* next;
+} EpochRecord;
+
+typedef struct Retired {
+    void* ptr;
+    retireFunc func;
+    uint64_t epoch;
+    struct Retired* next;
+} Retired;
+
+static uint64_t global_epoch = 1;
+static EpochRecord* records;   // only ever pushed onto, read without the lock
+
+// Retired objects oldest first, and the lock writers share to add to them
+static Retired* retired_head;
+static Retired* retired_tail;
+static pthread_mutex_t retire_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_key_t record_key;
+static pthread_once_t record_once = PTHREAD_ONCE_INIT;
+
+static void release_record(void* arg) {
+    EpochRecord* record = (EpochRecord*)arg;
+    __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&record->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void init_records(void) {
+    pthread_key_create(&record_key, release_record);
+}
+
+static EpochRecord* get_record(void) {
+    pthread_once(&record_once, init_records);
+    EpochRecord* record = pthread_getspecific(record_key);
+    if (record) return record;
+
+    // Reuse a record left by a thread that exited
+    for (record = __atomic_load_n(&records, __ATOMIC_ACQUIRE); record; record = record->next) {
+        int expected = 0;
+        if (__atomic_compare_exchange_n(&record->in_use, &expected, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (!record) {
+        record = calloc(1, sizeof(EpochRecord));
+        if (!record) abort();
+        record->in_use = 1;
+        record->next = __atomic_load_n(&records, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&records, &record->next, record, false,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+    pthread_setspecific(record_key, record);
+    return record;
+}
+
+void epochEnter(void) {
+    EpochRecord* record = get_record();
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+    // Sequentially consistent so the store is seen before any pointer this thread loads next
+    __atomic_store_n(&record->state, (epoch << 1) | 1, __ATOMIC_SEQ_CST);
+}
+
+void epochExit(void) {
+    EpochRecord* record = pthread_getspecific(record_key);
+    __atomic_store_n(&record->state, 0, __ATOMIC_RELEASE);
+}
+
+// Moves the epoch on if every reader has caught up with it, then frees what
+// was retired two epochs ago. Called with retire_mutex held.
+static void reclaim(void) {
+    uint64_t epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+    bool behind = false;
+
+    for (EpochRecord* record = __atomic_load_n(&records, __ATOMIC_ACQUIRE); record; record = record->next) {
+        uint64_t state = __atomic_load_n(&record->state, __ATOMIC_SEQ_CST);
+        if ((state & 1) && (state >> 1) != epoch) {
+            behind = true;
+            break;
+        }
+    }
+    if (!behind) {
+        epoch++;
+        __atomic_store_n(&global_epoch, epoch, __ATOMIC_SEQ_CST);
+    }
+
+    // Readers still in a section entered at epoch - 1 at the earliest
+    while (retired_head && retired_head->epoch + 2 <= epoch) {
+        Retired* item = retired_head;
+        retired_head = item->next;
+        if (!retired_head) retired_tail = NULL;
+        item->func(item->ptr);
+        free(item);
+    }
+}
+
+void epochRetire(void* ptr, retireFunc func) {
+    if (!ptr) return;
+
+    Retired* item = malloc(sizeof(Retired));
+    pthread_mutex_lock(&retire_mutex);
+    if (!item) {
+        // Can't queue it, leaking beats freeing under a reader
+        pthread_mutex_unlock(&retire_mutex);
+        return;
+    }
+    item->ptr = ptr;
+    item->func = func;
+    item->epoch = __atomic_load_n(&global_epoch, __ATOMIC_SEQ_CST);
+    item->next = NULL;
+    if (retired_tail) {
+        retired_tail->next = item;
+    } else {
+        retired_head = item;
+    }
+    retired_tail = item;
+    reclaim();
+    pthread_mutex_unlock(&retire_mutex);
+}
+
+void epochDrain(void) {
+    pthread_mutex_lock(&retire_mutex);
+    while (retired_head) {
+        Retired* item = retired_head;
+        retired_head = item->next;
+        item->func(item->ptr);
+        free(item);
+    }
+    retired_tail = NULL;
+    pthread_mutex_unlock(&retire_mutex);
+}
@@ -0,0 +1,24 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+// Epoch based reclamation. Readers bracket their use of shared pointers with
+// epochEnter/epochExit and never block; writers unlink an object, then retire
+// it, and it is freed once every reader that could have seen it has left.
+
+typedef void (*retireFunc)(void* ptr);
+
+// Starts a read section on the calling thread. Pointers loaded after this
+// stay valid until epochExit. Sections don't nest.
+void epochEnter(void);
+
+// Ends the calling thread's read section
+void epochExit(void);
+
+// Frees ptr with func once no read section can still see it.
+// ptr must already be unreachable for new readers.
+void epochRetire(void* ptr, retireFunc func);
+
+// Frees everything retired without waiting, only safe once no thread reads
+void epochDrain(void);
+
+#endif
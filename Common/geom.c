@@ -0,0 +1,285 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "geom.h"
+
+// Below these sizes the filter and the threads cost more than they save
+#define SIMD_MIN_POINTS 64
+#define PARALLEL_MIN_POINTS 65536
+#define PARALLEL_MAX_THREADS 16
+
+// Points are filtered in blocks so the mask stays on the stack
+#define FILTER_BLOCK 256
+#define FILTER_EDGES 8
+
+static HullEngine current_engine = HULL_ENGINE_SCALAR;
+static pthread_once_t engine_once = PTHREAD_ONCE_INIT;
+
+static const char* engine_names[] = { "scalar", "simd", "parallel" };
+
+static void init_engine(void) {
+    const char* name = getenv(HULL_ENGINE_ENV);
+    if (name && !parseHullEngine(name, &current_engine)) {
+        fprintf(stderr, "Unknown %s '%s', using %s\n", HULL_ENGINE_ENV, name,
+                engine_names[HULL_ENGINE_SCALAR]);
+        current_engine = HULL_ENGINE_SCALAR;
+    }
+}
+
+void setHullEngine(HullEngine engine) {
+    pthread_once(&engine_once, init_engine);
+    current_engine = engine;
+}
+
+HullEngine getHullEngine(void) {
+    pthread_once(&engine_once, init_engine);
+    return current_engine;
+}
+
+bool parseHullEngine(const char* name, HullEngine* engine) {
+    for (int i = 0; i <= HULL_ENGINE_PARALLEL; i++) {
+        if (strcmp(name, engine_names[i]) == 0) {
+            *engine = (HullEngine)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* hullEngineName(HullEngine engine) {
+    if (engine < HULL_ENGINE_SCALAR || engine > HULL_ENGINE_PARALLEL) return "unknown";
+    return engine_names[engine];
+}
+
+int orientation(Point p, Point q, Point r) {
+    // In double, like the area: the differences of two float coordinates are exact there
+    double val = ((double)q.y - p.y) * ((double)r.x - q.x) - ((double)q.x - p.x) * ((double)r.y - q.y);
+    if (fabs(val) < 1e-9) return 0;  // Colinear
+    return (val > 0) ? 1 : 2; // Clockwise or counterclockwise
+}
+
+int compare_points(const void *a, const void *b) {
+    Point *p1 = (Point *)a;
+    Point *p2 = (Point *)b;
+    if (p1->x != p2->x)
+        return (p1->x > p2->x) ? 1 : -1;
+    return (p1->y > p2->y) ? 1 : -1;
+}
+
+double calculate_polygon_area(Point points[], int n) {
+    double area = 0.0;
+    for (int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        area += ((double)points[i].x * points[j].y) - ((double)points[j].x * points[i].y);
+    }
+    return fabs(area) / 2.0;
+}
+
+// Andrew's monotone chain over points already sorted by compare_points (n >= 3)
+static int monotone_chain(const Point points[], int n, Point hull[]) {
+    int k = 0;
+
+    // Build lower hull
+    for (int i = 0; i < n; i++) {
+        while (k >= 2 && orientation(hull[k-2], hull[k-1], points[i]) != 2)
+            k--;
+        hull[k++] = points[i];
+    }
+
+    // Build upper hull
+    for (int i = n-2, t = k+1; i >= 0; i--) {
+        while (k >= t && orientation(hull[k-2], hull[k-1], points[i]) != 2)
+            k--;
+        hull[k++] = points[i];
+    }
+
+    return k-1; // The first point is repeated at the end
+}
+
+static int hull_scalar(Point points[], int n, Point hull[]) {
+    qsort(points, n, sizeof(Point), compare_points);
+    return monotone_chain(points, n, hull);
+}
+
+/**
+ * Akl-Toussaint heuristic: points strictly inside the polygon spanned by the
+ * extreme points in eight directions can't be on the hull. The mask loop is
+ * branch free so the compiler turns it into vector code, only the survivors
+ * are sorted. Points are left in their original order.
+ */
+static int hull_simd(Point points[], int n, Point hull[]) {
+    // Extremes in x, x+y, y, y-x, -x, -x-y, -y, x-y: counterclockwise around the hull
+    int ext[FILTER_EDGES] = {0};
+    for (int i = 1; i < n; i++) {
+        Coord x = points[i].x, y = points[i].y;
+        if (x > points[ext[0]].x) ext[0] = i;
+        if (x + y > points[ext[1]].x + points[ext[1]].y) ext[1] = i;
+        if (y > points[ext[2]].y) ext[2] = i;
+        if (y - x > points[ext[3]].y - points[ext[3]].x) ext[3] = i;
+        if (x < points[ext[4]].x) ext[4] = i;
+        if (x + y < points[ext[5]].x + points[ext[5]].y) ext[5] = i;
+        if (y < points[ext[6]].y) ext[6] = i;
+        if (y - x < points[ext[7]].y - points[ext[7]].x) ext[7] = i;
+    }
+
+    // Drop repeated corners, a zero length edge would keep every point
+    Point corners[FILTER_EDGES];
+    int m = 0;
+    for (int e = 0; e < FILTER_EDGES; e++) {
+        Point p = points[ext[e]];
+        if (m > 0 && p.x == corners[m-1].x && p.y == corners[m-1].y) continue;
+        if (m > 0 && e == FILTER_EDGES - 1 && p.x == corners[0].x && p.y == corners[0].y) continue;
+        corners[m++] = p;
+    }
+    if (m < 3) return hull_scalar(points, n, hull);
+
+    // Pad to a fixed edge count by repeating the last edge so the loop unrolls
+    Coord ax[FILTER_EDGES], ay[FILTER_EDGES], dx[FILTER_EDGES], dy[FILTER_EDGES];
+    for (int e = 0; e < FILTER_EDGES; e++) {
+        int from = e < m ? e : m - 1;
+        int to = (from + 1) % m;
+        ax[e] = corners[from].x;
+        ay[e] = corners[from].y;
+        dx[e] = corners[to].x - corners[from].x;
+        dy[e] = corners[to].y - corners[from].y;
+    }
+
+    Point* kept = malloc(n * sizeof(Point));
+    if (!kept) return hull_scalar(points, n, hull);
+
+    int k = 0;
+    unsigned char inside[FILTER_BLOCK];
+    for (int base = 0; base < n; base += FILTER_BLOCK) {
+        int len = n - base < FILTER_BLOCK ? n - base : FILTER_BLOCK;
+        const Point* block = points + base;
+
+        for (int i = 0; i < len; i++) {
+            Coord x = block[i].x, y = block[i].y;
+            unsigned char in = 1;
+            for (int e = 0; e < FILTER_EDGES; e++)
+                in &= dx[e] * (y - ay[e]) - dy[e] * (x - ax[e]) > 0;
+            inside[i] = in;
+        }
+        for (int i = 0; i < len; i++) {
+            kept[k] = block[i];
+            k += !inside[i];
+        }
+    }
+
+    // The corners themselves always survive, so there are at least 3 points
+    int size = hull_scalar(kept, k, hull);
+    free(kept);
+    return size;
+}
+
+typedef struct {
+    Point* points;
+    int n;
+    Point* hull;
+    int hull_size;
+} HullChunk;
+
+static void* hull_chunk(void* arg) {
+    HullChunk* chunk = (HullChunk*)arg;
+    if (chunk->n < 3) {
+        memcpy(chunk->hull, chunk->points, chunk->n * sizeof(Point));
+        chunk->hull_size = chunk->n;
+    } else {
+        chunk->hull_size = hull_simd(chunk->points, chunk->n, chunk->hull);
+    }
+    return NULL;
+}
+
+/**
+ * Splits the points into one chunk per CPU, hulls each chunk on its own thread
+ * and then hulls the union of the chunk hulls, which is the hull of the whole set
+ */
+static int hull_parallel(Point points[], int n, Point hull[]) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 1 ? (int)cpus : 1;
+    if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+    if (threads > n / (PARALLEL_MIN_POINTS / 4)) threads = n / (PARALLEL_MIN_POINTS / 4);
+    if (threads < 2) return hull_simd(points, n, hull);
+
+    HullChunk chunks[PARALLEL_MAX_THREADS];
+    pthread_t tids[PARALLEL_MAX_THREADS];
+    bool started[PARALLEL_MAX_THREADS];
+
+    // A chunk hull has at most one point more than the chunk
+    Point* chunk_hulls = malloc((n + 2 * threads) * sizeof(Point));
+    if (!chunk_hulls) return hull_simd(points, n, hull);
+
+    int offset = 0;
+    for (int t = 0; t < threads; t++) {
+        int len = n / threads + (t < n % threads ? 1 : 0);
+        chunks[t].points = points + offset;
+        chunks[t].n = len;
+        chunks[t].hull = chunk_hulls + offset + 2 * t;
+        offset += len;
+    }
+
+    // The calling thread takes the first chunk itself
+    for (int t = 1; t < threads; t++) {
+        started[t] = pthread_create(&tids[t], NULL, hull_chunk, &chunks[t]) == 0;
+        if (!started[t]) hull_chunk(&chunks[t]);
+    }
+    hull_chunk(&chunks[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) pthread_join(tids[t], NULL);
+    }
+
+    // Gather the chunk hulls at the front of the buffer, in order
+    int m = 0;
+    for (int t = 0; t < threads; t++) {
+        memmove(chunk_hulls + m, chunks[t].hull, chunks[t].hull_size * sizeof(Point));
+        m += chunks[t].hull_size;
+    }
+
+    int k;
+    if (m < 3) {
+        for (k = 0; k < m; k++) hull[k] = chunk_hulls[k];
+    } else {
+        k = hull_scalar(chunk_hulls, m, hull);
+    }
+    free(chunk_hulls);
+    return k;
+}
+
+int convex_hull(Point points[], int n, Point hull[]) {
+    // If there are less than 3 points, all points are part of the hull
+    if (n < 3) {
+        for (int i = 0; i < n; i++)
+            hull[i] = points[i];
+        return n;
+    }
+
+    switch (getHullEngine()) {
+    case HULL_ENGINE_PARALLEL:
+        if (n >= PARALLEL_MIN_POINTS) return hull_parallel(points, n, hull);
+        // fall through
+    case HULL_ENGINE_SIMD:
+        if (n >= SIMD_MIN_POINTS) return hull_simd(points, n, hull);
+        // fall through
+    case HULL_ENGINE_SCALAR:
+    default:
+        return hull_scalar(points, n, hull);
+    }
+}
+
+double convex_hull_array(Point points[], int n) {
+    if (n < 3) {
+        return calculate_polygon_area(points, n);
+    }
+
+    Point* hull = (Point*)malloc(n * 2 * sizeof(Point));
+    if (!hull) return 0.0;
+
+    int k = convex_hull(points, n, hull);
+    double area = calculate_polygon_area(hull, k);
+    free(hull);
+    return area;
+}
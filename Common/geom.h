@@ -0,0 +1,64 @@
+#ifndef GEOM_H
+#define GEOM_H
+
+#include <stdbool.h>
+
+// Coordinate type: float, unless built with GEOM_DOUBLE for servers that
+// need double precision coordinates (Q10)
+#ifdef GEOM_DOUBLE
+typedef double Coord;
+#else
+typedef float Coord;
+#endif
+
+// Structure for 2D point
+typedef struct {
+    Coord x;
+    Coord y;
+} Point;
+
+// Hull implementations, all of them produce the same hull
+typedef enum {
+    HULL_ENGINE_SCALAR,    // sort + monotone chain over every point
+    HULL_ENGINE_SIMD,      // vectorized interior point filter before the scan
+    HULL_ENGINE_PARALLEL   // hulls of chunks on several threads, then the hull of those
+} HullEngine;
+
+// Environment variable read on first use to pick the engine
+#define HULL_ENGINE_ENV "HULL_ENGINE"
+
+// Selects the engine used by convex_hull, meant to be called once at startup
+void setHullEngine(HullEngine engine);
+
+// Returns the engine in use, taken from HULL_ENGINE_ENV unless set explicitly
+HullEngine getHullEngine(void);
+
+// Maps "scalar", "simd" or "parallel" to an engine, returns false for anything else
+bool parseHullEngine(const char* name, HullEngine* engine);
+
+// Returns the name parseHullEngine accepts for the engine
+const char* hullEngineName(HullEngine engine);
+
+/**
+ * Orientation of the ordered points (p, q, r)
+ * 0 - Colinear, 1 - Clockwise, 2 - Counterclockwise
+ */
+int orientation(Point p, Point q, Point r);
+
+// qsort() comparator ordering points by x, then by y
+int compare_points(const void *a, const void *b);
+
+// Area of a polygon given its vertices in order (shoelace formula), summed
+// in double so large coordinates don't lose the fraction
+double calculate_polygon_area(Point points[], int n);
+
+/**
+ * Computes the convex hull of points into hull, which needs room for 2 * n points
+ * points may be reordered. Returns the number of points in the hull
+ */
+int convex_hull(Point points[], int n, Point hull[]);
+
+// Area of the convex hull of points, points may be reordered
+double convex_hull_array(Point points[], int n);
+
+#endif
@@ -0,0 +1,852 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "graph.h"
+#include "epoch.h"
+#include "affinity.h"
+#include "lockprof.h"
+
+#define GRAPH_BUCKETS 256
+#define GRAPH_CHUNK_POINTS 1024
+
+// Newpoints queued per graph, a power of two, and how many make a batch worth applying early
+#define MUTATION_RING 1024
+#define MUTATION_BATCH 256
+
+#define SHARD_INITIAL_POINTS 64
+
+// A run of points shared by every version that lists it. Slots below the
+// count a version sees never change, so the writer may append past them in place.
+typedef struct {
+    int refs;   // versions listing the chunk
+    int used;   // slots written, only the graph's writer touches it
+    Point points[GRAPH_CHUNK_POINTS];
+} PointChunk;
+
+typedef struct {
+    PointChunk* chunk;
+    int count;   // points of the chunk this version holds
+} ChunkRef;
+
+// One immutable state of a graph. A mutation builds the next version out of
+// the chunks it didn't touch, so it costs a chunk and the list, not the graph.
+typedef struct {
+    uint64_t serial;   // one more than the version it replaced
+    int num_points;
+    int chunk_count;
+    ChunkRef chunks[];
+} GraphVersion;
+
+// A queued Newpoint. seq is the slot's position while free, position + 1 once
+// written, and position + MUTATION_RING again after the owner took it.
+typedef struct {
+    uint64_t seq;
+    Point point;
+} Mutation;
+
+// Sharded mode keeps a graph's points in separate sets picked by a hash of
+// the coordinates, each with its own lock and a cached hull. A sharded graph
+// doesn't use the Newpoint ring or the CH single flight below.
+typedef struct {
+    ProfiledMutex mutex;
+    Point* points;
+    int count;
+    int capacity;
+    Point* hull;        // counterclockwise, up to date while hull_valid
+    int hull_size;
+    int hull_capacity;
+    bool hull_valid;
+    char pad[64];       // shards sit in one array, keep their locks apart
+} GraphShard;
+
+// Readers load version without locks inside an epoch section, writers take
+// the mutex, publish a new version and retire the old one.
+// Newpoint doesn't take the mutex: producers claim ring slots at tail with a
+// CAS, and whoever holds the mutex applies everything from head in one version.
+struct Graph {
+    char name[GRAPH_NAME_MAX];
+    GraphVersion* version;
+    ProfiledMutex write_mutex;
+    struct Graph* next;
+    GraphShard* shards;   // NULL unless sharded, then version and the ring stay unused
+    int shard_count;
+    uint64_t generation;  // bumped by Newgraph while it holds every shard lock
+    int reserved;         // points held or queued, only kept with a point limit
+
+    // CH single flight: one caller hulls a version while callers asking for
+    // the same version wait for its answer, which stays cached until replaced
+    ProfiledMutex hull_mutex;
+    pthread_cond_t hull_done;
+    uint64_t hull_serial;   // version being hulled, or hulled last
+    bool hull_running;
+    bool hull_known;        // hull_area is the answer for hull_serial
+    double hull_area;
+
+    uint64_t tail;
+    char pad[64];   // keeps producers off the line the owner writes
+    uint64_t head;
+    Mutation ring[MUTATION_RING];
+};
+
+// Per thread buffer CH sorts, reused so repeated hulls don't allocate
+typedef struct {
+    Point* points;
+    int capacity;
+} Scratch;
+
+static pthread_key_t scratch_key;
+
+// Shards given to graphs created from now on, 0 for unsharded graphs
+static int shards_setting = 0;
+
+// Named graphs that may exist besides the default one, 0 for no limit,
+// and how many do. Graphs are never dropped, so every Use of a new name
+// would otherwise keep memory for good.
+static int max_graphs_setting = DEFAULT_MAX_GRAPHS;
+static int named_graphs = 0;
+
+// Points a graph may hold, 0 for no limit
+static int max_points_setting = 0;
+
+// Each bucket has its own lock so lookups of unrelated names don't contend
+typedef struct {
+    Graph* head;
+    ProfiledMutex mutex;
+} GraphBucket;
+
+static GraphBucket buckets[GRAPH_BUCKETS];
+
+// Lock profiles, each adds up one kind of lock over every graph
+static LockProfile store_profile = LOCK_PROFILE_INITIALIZER("graph_store");
+static LockProfile write_profile = LOCK_PROFILE_INITIALIZER("graph_write");
+static LockProfile hull_profile = LOCK_PROFILE_INITIALIZER("graph_hull");
+static LockProfile shard_profile = LOCK_PROFILE_INITIALIZER("graph_shard");
+static pthread_once_t buckets_once = PTHREAD_ONCE_INIT;
+
+static void free_scratch(void* arg) {
+    Scratch* scratch = (Scratch*)arg;
+    free(scratch->points);
+    free(scratch);
+}
+
+static void init_buckets(void) {
+    for (int i = 0; i < GRAPH_BUCKETS; i++) {
+        buckets[i].head = NULL;
+        initProfiledMutex(&buckets[i].mutex, &store_profile);
+    }
+    pthread_key_create(&scratch_key, free_scratch);
+}
+
+// Returns the calling thread's scratch buffer with room for n points
+static Scratch* get_scratch(int n) {
+    Scratch* scratch = pthread_getspecific(scratch_key);
+    if (!scratch) {
+        scratch = calloc(1, sizeof(Scratch));
+        if (!scratch) return NULL;
+        pthread_setspecific(scratch_key, scratch);
+    }
+    if (scratch->capacity < n) {
+        Point* grown = realloc(scratch->points, n * sizeof(Point));
+        if (!grown) return NULL;
+        scratch->points = grown;
+        scratch->capacity = n;
+        // A worker pinned to one socket sorts in that socket's memory
+        localizeMemory(grown, n * sizeof(Point));
+    }
+    return scratch;
+}
+
+static GraphVersion* new_version(int chunk_count) {
+    GraphVersion* version = malloc(sizeof(GraphVersion) + chunk_count * sizeof(ChunkRef));
+    if (!version) return NULL;
+    version->serial = 0;
+    version->num_points = 0;
+    version->chunk_count = chunk_count;
+    return version;
+}
+
+// Drops the version's hold on its chunks, run by the epoch reclaimer
+static void free_version(void* arg) {
+    GraphVersion* version = (GraphVersion*)arg;
+    for (int i = 0; i < version->chunk_count; i++) {
+        PointChunk* chunk = version->chunks[i].chunk;
+        if (__atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0) free(chunk);
+    }
+    free(version);
+}
+
+static PointChunk* new_chunk(void) {
+    PointChunk* chunk = NULL;
+    if (interleaveEnabled()) {
+        // Whole pages of its own, so the chunk's policy doesn't leak onto its neighbours
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t size = (sizeof(PointChunk) + page - 1) / page * page;
+        void* memory;
+        if (posix_memalign(&memory, page, size) != 0) return NULL;
+        interleaveMemory(memory, size);
+        chunk = memory;
+    } else {
+        chunk = malloc(sizeof(PointChunk));
+    }
+    if (!chunk) return NULL;
+    chunk->refs = 0;
+    chunk->used = 0;
+    return chunk;
+}
+
+static void set_chunk(GraphVersion* version, int index, PointChunk* chunk, int count) {
+    version->chunks[index].chunk = chunk;
+    version->chunks[index].count = count;
+    __atomic_add_fetch(&chunk->refs, 1, __ATOMIC_RELAXED);
+}
+
+// Makes version the graph's current one, called with the write mutex held
+static void publish(Graph* graph, GraphVersion* version) {
+    version->serial = graph->version->serial + 1;
+    GraphVersion* old = __atomic_exchange_n(&graph->version, version, __ATOMIC_ACQ_REL);
+    epochRetire(old, free_version);
+}
+
+// Builds and publishes a version with k more points, called with the write mutex held
+static int append_points(Graph* graph, const Point* points, int k) {
+    GraphVersion* old = graph->version;
+
+    // Room in the last chunk that no version has seen takes the first points in place
+    int last = old->chunk_count - 1;
+    int room = 0;
+    if (last >= 0 && old->chunks[last].chunk->used == old->chunks[last].count) {
+        room = GRAPH_CHUNK_POINTS - old->chunks[last].count;
+    }
+    int in_place = k < room ? k : room;
+    int fresh = (k - in_place + GRAPH_CHUNK_POINTS - 1) / GRAPH_CHUNK_POINTS;
+
+    GraphVersion* version = new_version(old->chunk_count + fresh);
+    if (!version) return -1;
+    for (int i = 0; i < fresh; i++) {
+        PointChunk* chunk = new_chunk();
+        if (!chunk) {
+            while (i-- > 0) free(version->chunks[old->chunk_count + i].chunk);
+            free(version);
+            return -1;
+        }
+        version->chunks[old->chunk_count + i].chunk = chunk;
+    }
+
+    for (int i = 0; i < old->chunk_count; i++) {
+        set_chunk(version, i, old->chunks[i].chunk, old->chunks[i].count);
+    }
+    for (int i = old->chunk_count; i < version->chunk_count; i++) {
+        set_chunk(version, i, version->chunks[i].chunk, 0);
+    }
+
+    int c = in_place > 0 ? last : old->chunk_count;
+    for (int i = 0; i < k; i++) {
+        ChunkRef* ref = &version->chunks[c];
+        if (ref->count == GRAPH_CHUNK_POINTS) ref = &version->chunks[++c];
+        ref->chunk->points[ref->count++] = points[i];
+        ref->chunk->used = ref->count;
+    }
+    version->num_points = old->num_points + k;
+
+    publish(graph, version);
+    return 0;
+}
+
+void setMaxGraphPoints(int max_points) {
+    max_points_setting = max_points > 0 ? max_points : 0;
+}
+
+// Takes a place for one more point, false at the limit. Without a limit
+// nothing is counted, so Newpoint stays free of shared writes.
+static bool reserve_point(Graph* graph) {
+    if (!max_points_setting) return true;
+    if (__atomic_add_fetch(&graph->reserved, 1, __ATOMIC_RELAXED) <= max_points_setting) return true;
+    __atomic_sub_fetch(&graph->reserved, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+// Adds delta (negative to give places back) to the points reserved
+static void adjust_points(Graph* graph, int delta) {
+    if (max_points_setting) __atomic_add_fetch(&graph->reserved, delta, __ATOMIC_RELAXED);
+}
+
+// Queues a Newpoint without locking, returns false if the ring is full
+static bool enqueue_point(Graph* graph, Coord x, Coord y) {
+    uint64_t pos = __atomic_load_n(&graph->tail, __ATOMIC_RELAXED);
+    for (;;) {
+        Mutation* slot = &graph->ring[pos & (MUTATION_RING - 1)];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&graph->tail, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                slot->point.x = x;
+                slot->point.y = y;
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&graph->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static uint64_t pending_points(Graph* graph) {
+    return __atomic_load_n(&graph->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&graph->head, __ATOMIC_RELAXED);
+}
+
+// Takes every Newpoint queued so far and applies them as one version, or drops
+// them when keep is false. Called with the write mutex held. If the version
+// can't be allocated the points stay queued for the next call and -1 is returned.
+static int apply_pending(Graph* graph, bool keep) {
+    Point batch[MUTATION_RING];
+    int k = 0;
+    uint64_t pos = graph->head;
+    uint64_t end = __atomic_load_n(&graph->tail, __ATOMIC_ACQUIRE);
+
+    while (pos != end) {
+        Mutation* slot = &graph->ring[pos & (MUTATION_RING - 1)];
+        // A producer between claiming and filling its slot finishes in a few instructions,
+        // its client hasn't been acknowledged yet but later slots may have been
+        while (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) sched_yield();
+        batch[k++] = slot->point;
+        pos++;
+    }
+    if (k > 0 && keep && append_points(graph, batch, k) != 0) return -1;
+    if (!keep) adjust_points(graph, -k);
+
+    // Slots are only handed back to producers once their points are in a version
+    for (uint64_t p = graph->head; p != end; p++) {
+        __atomic_store_n(&graph->ring[p & (MUTATION_RING - 1)].seq, p + MUTATION_RING, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&graph->head, end, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void setGraphShards(int shards) {
+    shards_setting = shards > 1 ? shards : 0;
+}
+
+void setMaxGraphs(int max_graphs) {
+    max_graphs_setting = max_graphs > 0 ? max_graphs : 0;
+}
+
+// Takes a place for a new named graph, false past the limit
+static bool reserve_graph(const char* name) {
+    if (strcmp(name, DEFAULT_GRAPH) == 0) return true;
+    if (__atomic_add_fetch(&named_graphs, 1, __ATOMIC_RELAXED) <= max_graphs_setting ||
+        max_graphs_setting == 0) {
+        return true;
+    }
+    __atomic_sub_fetch(&named_graphs, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+static void unreserve_graph(const char* name) {
+    if (strcmp(name, DEFAULT_GRAPH) != 0) __atomic_sub_fetch(&named_graphs, 1, __ATOMIC_RELAXED);
+}
+
+// Equal points always land on the same shard, so a removal looks in one place
+static GraphShard* shard_of(Graph* graph, Coord x, Coord y) {
+    // -0 equals 0, give them the same bits
+    if (x == 0) x = 0;
+    if (y == 0) y = 0;
+    uint64_t bx = 0, by = 0;
+    memcpy(&bx, &x, sizeof(x));
+    memcpy(&by, &y, sizeof(y));
+    // Folded to 32 bits, a float's bits stay as they are
+    uint32_t h = (uint32_t)(bx ^ bx >> 32) * 0x9e3779b1u ^ (uint32_t)(by ^ by >> 32) * 0x85ebca77u;
+    h ^= h >> 15;
+    h *= 0xc2b2ae3du;
+    h ^= h >> 13;
+    return &graph->shards[h % (uint32_t)graph->shard_count];
+}
+
+// A point inside or on the cached hull leaves it as it is
+static bool inside_hull(const GraphShard* shard, Point p) {
+    if (shard->hull_size < 3) return false;
+    for (int i = 0; i < shard->hull_size; i++) {
+        Point a = shard->hull[i];
+        Point b = shard->hull[(i + 1) % shard->hull_size];
+        if (orientation(a, b, p) == 1) return false;
+    }
+    return true;
+}
+
+static bool is_hull_vertex(const GraphShard* shard, Point p) {
+    for (int i = 0; i < shard->hull_size; i++) {
+        if (shard->hull[i].x == p.x && shard->hull[i].y == p.y) return true;
+    }
+    return false;
+}
+
+// Recomputes a stale hull, called with the shard's lock held
+static int refresh_shard_hull(GraphShard* shard) {
+    if (shard->hull_valid) return 0;
+    if (shard->hull_capacity < 2 * shard->count) {
+        Point* grown = realloc(shard->hull, 2 * shard->count * sizeof(Point));
+        if (!grown) return -1;
+        shard->hull = grown;
+        shard->hull_capacity = 2 * shard->count;
+    }
+    shard->hull_size = shard->count > 0 ? convex_hull(shard->points, shard->count, shard->hull) : 0;
+    shard->hull_valid = true;
+    return 0;
+}
+
+static int sharded_add(Graph* graph, Coord x, Coord y) {
+    GraphShard* shard = shard_of(graph, x, y);
+    Point p = { x, y };
+
+    lockProfiled(&shard->mutex);
+    if (shard->count == shard->capacity) {
+        int capacity = shard->capacity ? shard->capacity * 2 : SHARD_INITIAL_POINTS;
+        Point* grown = realloc(shard->points, capacity * sizeof(Point));
+        if (!grown) {
+            unlockProfiled(&shard->mutex);
+            return -1;
+        }
+        shard->points = grown;
+        shard->capacity = capacity;
+    }
+    shard->points[shard->count++] = p;
+    if (shard->hull_valid && !inside_hull(shard, p)) shard->hull_valid = false;
+    unlockProfiled(&shard->mutex);
+    return 0;
+}
+
+static bool sharded_remove(Graph* graph, Coord x, Coord y) {
+    GraphShard* shard = shard_of(graph, x, y);
+    bool found = false;
+
+    lockProfiled(&shard->mutex);
+    for (int i = 0; i < shard->count; i++) {
+        Point p = shard->points[i];
+        // Exact, like shard_of: a point within some tolerance could sit in another shard
+        if (p.x == x && p.y == y) {
+            // Only a hull vertex can change the hull
+            if (shard->hull_valid && is_hull_vertex(shard, p)) shard->hull_valid = false;
+            // Order within a shard doesn't matter, so the last point fills the gap
+            shard->points[i] = shard->points[--shard->count];
+            found = true;
+            break;
+        }
+    }
+    unlockProfiled(&shard->mutex);
+    return found;
+}
+
+// Splits the new points by shard, then swaps every shard at once.
+// Returns -1, leaving the graph as it was, if the shard arrays can't be allocated.
+static int sharded_set(Graph* graph, Point* points, int n) {
+    int count = graph->shard_count;
+    Point** arrays = calloc(count, sizeof(Point*));
+    int* sizes = calloc(count, sizeof(int));
+    bool ok = arrays && sizes;
+
+    for (int i = 0; ok && i < n; i++) {
+        sizes[shard_of(graph, points[i].x, points[i].y) - graph->shards]++;
+    }
+    for (int s = 0; ok && s < count; s++) {
+        int capacity = sizes[s] > SHARD_INITIAL_POINTS ? sizes[s] : SHARD_INITIAL_POINTS;
+        arrays[s] = malloc(capacity * sizeof(Point));
+        if (!arrays[s]) ok = false;
+        sizes[s] = 0;
+    }
+    if (!ok) {
+        for (int s = 0; arrays && s < count; s++) free(arrays[s]);
+        free(arrays);
+        free(sizes);
+        free(points);
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        int s = (int)(shard_of(graph, points[i].x, points[i].y) - graph->shards);
+        arrays[s][sizes[s]++] = points[i];
+    }
+    free(points);
+
+    // Locks go in index order, the same order CH visits the shards in
+    for (int s = 0; s < count; s++) lockProfiled(&graph->shards[s].mutex);
+    graph->generation++;
+    for (int s = 0; s < count; s++) {
+        GraphShard* shard = &graph->shards[s];
+        Point* old = shard->points;
+        adjust_points(graph, sizes[s] - shard->count);
+        shard->points = arrays[s];
+        shard->count = sizes[s];
+        shard->capacity = sizes[s] > SHARD_INITIAL_POINTS ? sizes[s] : SHARD_INITIAL_POINTS;
+        shard->hull_valid = false;
+        arrays[s] = old;
+    }
+    for (int s = count - 1; s >= 0; s--) unlockProfiled(&graph->shards[s].mutex);
+
+    for (int s = 0; s < count; s++) free(arrays[s]);
+    free(arrays);
+    free(sizes);
+    return 0;
+}
+
+// Gathers each shard's cached hull, then hulls those few points. A Newgraph
+// landing halfway through shows up as a changed generation and the pass repeats.
+static int sharded_hull_area(Graph* graph, double* area) {
+    for (;;) {
+        uint64_t generation = 0;
+        bool torn = false;
+        int n = 0;
+        int m = 0;
+        Scratch* scratch = NULL;
+
+        for (int s = 0; s < graph->shard_count; s++) {
+            GraphShard* shard = &graph->shards[s];
+            lockProfiled(&shard->mutex);
+            if (s == 0) {
+                generation = graph->generation;
+            } else if (graph->generation != generation) {
+                torn = true;
+            }
+            if (!torn && refresh_shard_hull(shard) == 0 &&
+                (scratch = get_scratch(m + shard->hull_size)) != NULL) {
+                memcpy(scratch->points + m, shard->hull, shard->hull_size * sizeof(Point));
+                m += shard->hull_size;
+                n += shard->count;
+            } else if (!torn) {
+                // Out of memory, same answer as a failed allocation inside the hull
+                unlockProfiled(&shard->mutex);
+                *area = 0.0;
+                return n;
+            }
+            unlockProfiled(&shard->mutex);
+            if (torn) break;
+        }
+        if (torn) continue;
+
+        if (n > 0) *area = convex_hull_array(scratch->points, m);
+        return n;
+    }
+}
+
+// FNV-1a hash of the graph name
+static unsigned int hash_name(const char* name) {
+    unsigned int h = 2166136261u;
+    for (; *name; name++) {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool isValidGraphName(const char* name) {
+    size_t len = strlen(name);
+    if (len == 0 || len >= GRAPH_NAME_MAX) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (name[i] <= ' ' || name[i] == 0x7f) return false;
+    }
+    return true;
+}
+
+Graph* getGraph(const char* name) {
+    Graph* graph;
+    return findGraph(name, &graph) == GRAPH_OK ? graph : NULL;
+}
+
+int findGraph(const char* name, Graph** found) {
+    *found = NULL;
+    if (!name || !isValidGraphName(name)) return GRAPH_INVALID_NAME;
+    pthread_once(&buckets_once, init_buckets);
+    int result = GRAPH_OK;
+
+    GraphBucket* bucket = &buckets[hash_name(name) % GRAPH_BUCKETS];
+    lockProfiled(&bucket->mutex);
+
+    Graph* graph = bucket->head;
+    while (graph && strcmp(graph->name, name) != 0) {
+        graph = graph->next;
+    }
+
+    if (!graph && !reserve_graph(name)) {
+        result = GRAPH_TOO_MANY;
+    } else if (!graph) {
+        graph = calloc(1, sizeof(Graph));
+        if (graph) {
+            graph->version = new_version(0);
+            if (shards_setting) {
+                graph->shards = calloc(shards_setting, sizeof(GraphShard));
+                graph->shard_count = shards_setting;
+                for (int i = 0; graph->shards && i < graph->shard_count; i++) {
+                    initProfiledMutex(&graph->shards[i].mutex, &shard_profile);
+                }
+            }
+            if (!graph->version || (shards_setting && !graph->shards)) {
+                free(graph->version);
+                free(graph->shards);
+                free(graph);
+                graph = NULL;
+            }
+        }
+        if (graph) {
+            strcpy(graph->name, name);
+            initProfiledMutex(&graph->write_mutex, &write_profile);
+            initProfiledMutex(&graph->hull_mutex, &hull_profile);
+            pthread_cond_init(&graph->hull_done, NULL);
+            for (int i = 0; i < MUTATION_RING; i++) graph->ring[i].seq = i;
+            graph->next = bucket->head;
+            bucket->head = graph;
+        } else {
+            unreserve_graph(name);
+            result = GRAPH_NO_MEMORY;
+        }
+    }
+
+    unlockProfiled(&bucket->mutex);
+    *found = graph;
+    return result;
+}
+
+const char* getGraphName(const Graph* graph) {
+    return graph->name;
+}
+
+int setGraphPoints(Graph* graph, Point* points, int n) {
+    if (max_points_setting && n > max_points_setting) {
+        free(points);
+        return -1;
+    }
+    if (graph->shards) return sharded_set(graph, points, n);
+
+    int chunk_count = (n + GRAPH_CHUNK_POINTS - 1) / GRAPH_CHUNK_POINTS;
+    GraphVersion* version = new_version(chunk_count);
+    if (!version) {
+        free(points);
+        return -1;
+    }
+
+    for (int i = 0; i < chunk_count; i++) {
+        PointChunk* chunk = new_chunk();
+        if (!chunk) {
+            version->chunk_count = i;
+            free_version(version);
+            free(points);
+            return -1;
+        }
+        int count = n - i * GRAPH_CHUNK_POINTS;
+        if (count > GRAPH_CHUNK_POINTS) count = GRAPH_CHUNK_POINTS;
+        memcpy(chunk->points, points + i * GRAPH_CHUNK_POINTS, count * sizeof(Point));
+        chunk->used = count;
+        set_chunk(version, i, chunk, count);
+    }
+    version->num_points = n;
+    free(points);
+
+    // Points queued before the new graph would be replaced anyway
+    lockProfiled(&graph->write_mutex);
+    apply_pending(graph, false);
+    adjust_points(graph, n - graph->version->num_points);
+    publish(graph, version);
+    unlockProfiled(&graph->write_mutex);
+    return 0;
+}
+
+int addGraphPoint(Graph* graph, Coord x, Coord y) {
+    if (!reserve_point(graph)) return -1;
+    if (graph->shards) {
+        int rc = sharded_add(graph, x, y);
+        if (rc != 0) adjust_points(graph, -1);
+        return rc;
+    }
+
+    while (!enqueue_point(graph, x, y)) {
+        // Ring full, empty it here and try again
+        lockProfiled(&graph->write_mutex);
+        int rc = apply_pending(graph, true);
+        unlockProfiled(&graph->write_mutex);
+        if (rc != 0) {
+            adjust_points(graph, -1);
+            return -1;
+        }
+    }
+
+    // A full batch is applied by whichever producer finds the mutex free
+    if (pending_points(graph) >= MUTATION_BATCH && tryLockProfiled(&graph->write_mutex) == 0) {
+        apply_pending(graph, true);
+        unlockProfiled(&graph->write_mutex);
+    }
+    return 0;
+}
+
+// Returns false if the point isn't there, or if the new version can't be allocated
+bool removeGraphPoint(Graph* graph, Coord x, Coord y) {
+    if (graph->shards) {
+        bool found = sharded_remove(graph, x, y);
+        if (found) adjust_points(graph, -1);
+        return found;
+    }
+
+    // The reply says whether the point was there, so this one isn't queued
+    lockProfiled(&graph->write_mutex);
+    apply_pending(graph, true);
+    GraphVersion* old = graph->version;
+
+    int found_chunk = -1, found_index = -1;
+    for (int c = 0; c < old->chunk_count && found_chunk == -1; c++) {
+        const Point* points = old->chunks[c].chunk->points;
+        for (int i = 0; i < old->chunks[c].count; i++) {
+            if (fabs(points[i].x - x) < 1e-9 && fabs(points[i].y - y) < 1e-9) {
+                found_chunk = c;
+                found_index = i;
+                break;
+            }
+        }
+    }
+    if (found_chunk == -1) {
+        unlockProfiled(&graph->write_mutex);
+        return false;
+    }
+
+    // Only the chunk holding the point is copied, an emptied one is dropped
+    const ChunkRef* hit = &old->chunks[found_chunk];
+    int remaining = hit->count - 1;
+    GraphVersion* version = new_version(old->chunk_count - (remaining == 0 ? 1 : 0));
+    PointChunk* copy = remaining > 0 ? new_chunk() : NULL;
+    if (!version || (remaining > 0 && !copy)) {
+        unlockProfiled(&graph->write_mutex);
+        free(version);
+        free(copy);
+        return false;
+    }
+    if (copy) {
+        memcpy(copy->points, hit->chunk->points, found_index * sizeof(Point));
+        memcpy(copy->points + found_index, hit->chunk->points + found_index + 1,
+               (remaining - found_index) * sizeof(Point));
+        copy->used = remaining;
+    }
+
+    int next = 0;
+    for (int c = 0; c < old->chunk_count; c++) {
+        if (c != found_chunk) {
+            set_chunk(version, next++, old->chunks[c].chunk, old->chunks[c].count);
+        } else if (copy) {
+            set_chunk(version, next++, copy, remaining);
+        }
+    }
+    version->num_points = old->num_points - 1;
+
+    publish(graph, version);
+    adjust_points(graph, -1);
+    unlockProfiled(&graph->write_mutex);
+    return true;
+}
+
+// Copies the current version's points without taking a lock, then sorts the
+// copy, so writers never wait for a hull and a hull never waits for writers
+int graphHullArea(Graph* graph, double* area) {
+    if (graph->shards) return sharded_hull_area(graph, area);
+
+    // Acknowledged Newpoints must be in the hull. Out of memory leaves them
+    // queued and the hull is taken over the points already applied.
+    if (pending_points(graph) > 0) {
+        lockProfiled(&graph->write_mutex);
+        apply_pending(graph, true);
+        unlockProfiled(&graph->write_mutex);
+    }
+
+    for (;;) {
+        epochEnter();
+        const GraphVersion* version = __atomic_load_n(&graph->version, __ATOMIC_ACQUIRE);
+        int n = version->num_points;
+        uint64_t serial = version->serial;
+        if (n == 0) {
+            epochExit();
+            return 0;
+        }
+
+        lockProfiled(&graph->hull_mutex);
+        if (graph->hull_running && graph->hull_serial == serial) {
+            // A burst of CH on an unchanged graph costs one hull
+            epochExit();
+            while (graph->hull_running && graph->hull_serial == serial) {
+                waitProfiled(&graph->hull_done, &graph->hull_mutex);
+            }
+            bool known = graph->hull_known && graph->hull_serial == serial;
+            if (known) *area = graph->hull_area;
+            unlockProfiled(&graph->hull_mutex);
+            if (known) return n;
+            continue;   // its copy failed, try our own
+        }
+        if (graph->hull_known && graph->hull_serial == serial) {
+            *area = graph->hull_area;
+            unlockProfiled(&graph->hull_mutex);
+            epochExit();
+            return n;
+        }
+        // While another version is in flight this one is hulled alone
+        bool leader = !graph->hull_running;
+        if (leader) {
+            graph->hull_running = true;
+            graph->hull_serial = serial;
+            graph->hull_known = false;
+        }
+        unlockProfiled(&graph->hull_mutex);
+
+        Scratch* scratch = get_scratch(n);
+        if (scratch) {
+            Point* out = scratch->points;
+            for (int c = 0; c < version->chunk_count; c++) {
+                memcpy(out, version->chunks[c].chunk->points, version->chunks[c].count * sizeof(Point));
+                out += version->chunks[c].count;
+            }
+        }
+        epochExit();
+
+        // Same answer as a failed allocation inside the hull
+        double result = scratch ? convex_hull_array(scratch->points, n) : 0.0;
+        if (leader) {
+            lockProfiled(&graph->hull_mutex);
+            if (scratch) {
+                graph->hull_known = true;
+                graph->hull_area = result;
+            }
+            graph->hull_running = false;
+            pthread_cond_broadcast(&graph->hull_done);
+            unlockProfiled(&graph->hull_mutex);
+        }
+        *area = result;
+        return n;
+    }
+}
+
+void destroyGraphs(void) {
+    pthread_once(&buckets_once, init_buckets);
+    for (int i = 0; i < GRAPH_BUCKETS; i++) {
+        lockProfiled(&buckets[i].mutex);
+        Graph* graph = buckets[i].head;
+        while (graph) {
+            Graph* next = graph->next;
+            destroyProfiledMutex(&graph->write_mutex);
+            destroyProfiledMutex(&graph->hull_mutex);
+            pthread_cond_destroy(&graph->hull_done);
+            free_version(graph->version);
+            for (int s = 0; s < graph->shard_count; s++) {
+                destroyProfiledMutex(&graph->shards[s].mutex);
+                free(graph->shards[s].points);
+                free(graph->shards[s].hull);
+            }
+            free(graph->shards);
+            free(graph);
+            graph = next;
+        }
+        buckets[i].head = NULL;
+        unlockProfiled(&buckets[i].mutex);
+    }
+    named_graphs = 0;
+    // Older versions still hold chunks the current ones shared
+    epochDrain();
+}
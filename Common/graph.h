@@ -0,0 +1,67 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdbool.h>
+#include "geom.h"
+
+#define GRAPH_NAME_MAX 64
+#define DEFAULT_GRAPH "default"
+#define DEFAULT_MAX_GRAPHS 1024
+
+// Results of findGraph
+#define GRAPH_OK 0
+#define GRAPH_INVALID_NAME 1
+#define GRAPH_TOO_MANY 2      // creating it would pass the limit of setMaxGraphs
+#define GRAPH_NO_MEMORY 3
+
+typedef struct Graph Graph;
+
+// Makes graphs created from now on split their points over shards picked by
+// a hash of the coordinates, each with its own lock and cached hull; CH merges
+// the shard hulls. 0 or 1 keeps graphs unsharded. Call before the first getGraph.
+void setGraphShards(int shards);
+
+// Caps the named graphs that can be created besides the default one, which
+// always can be; 0 for no limit. DEFAULT_MAX_GRAPHS until set.
+void setMaxGraphs(int max_graphs);
+
+// Caps the points each graph can hold, Newpoints still queued included.
+// 0 (the default) for no limit. Call before the first getGraph.
+void setMaxGraphPoints(int max_points);
+
+// Returns the graph registered under name, creating an empty one on first use.
+// NULL if it can't be created, see findGraph for why.
+Graph* getGraph(const char* name);
+
+// Same as getGraph, stores the graph (NULL on failure) in *found and returns
+// GRAPH_OK or why it couldn't be found or created
+int findGraph(const char* name, Graph** found);
+
+// Returns the name the graph is registered under
+const char* getGraphName(const Graph* graph);
+
+// Replaces all points of the graph, takes ownership of points.
+// Returns -1, leaving the graph as it was, if the new points can't be allocated
+// or are more than the point limit.
+int setGraphPoints(Graph* graph, Point* points, int n);
+
+// Appends a point to the graph. The point is queued without locking and
+// applied in a batch, at the latest before the next hull or removal.
+// Returns -1 if the graph is at its point limit, or if the queue is full and
+// can't be applied for lack of memory.
+int addGraphPoint(Graph* graph, Coord x, Coord y);
+
+// Removes the first point equal to (x, y)
+bool removeGraphPoint(Graph* graph, Coord x, Coord y);
+
+// Computes the convex hull area, returns the number of points in the graph.
+// Points are stored as Coord, the area is computed and returned in double.
+int graphHullArea(Graph* graph, double* area);
+
+// Checks that name can be used as a graph name
+bool isValidGraphName(const char* name);
+
+// Frees every registered graph
+void destroyGraphs(void);
+
+#endif
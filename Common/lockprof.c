@@ -0,0 +1,278 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include "lockprof.h"
+
+static bool profiling = false;   // only written before the server starts threads
+static pthread_key_t command_key;
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LockProfile* registry = NULL;
+
+static const char* command_names[LOCK_COMMANDS] = {
+    "none", "Newgraph", "Newpoint", "Removepoint", "CH", "Use", "Stats"
+};
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int bucket_of(uint64_t ns) {
+    int bucket = 0;
+    while (ns > 0 && bucket < LOCK_HISTOGRAM_BUCKETS - 1) {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static void update_max(uint64_t* max, uint64_t value) {
+    uint64_t seen = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(max, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// Profiles join the report the first time they count something
+static void register_profile(LockProfile* profile) {
+    if (__atomic_load_n(&profile->registered, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&registry_mutex);
+    if (!profile->registered) {
+        profile->next = registry;
+        registry = profile;
+        __atomic_store_n(&profile->registered, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+static int current_command(void) {
+    return (int)(intptr_t)pthread_getspecific(command_key);
+}
+
+static void record_acquire(ProfiledMutex* mutex, bool contended, uint64_t wait_ns, uint64_t now) {
+    LockProfile* profile = mutex->profile;
+    int command = current_command();
+    register_profile(profile);
+
+    LockCommandStats* stats = &profile->commands[command];
+    __atomic_fetch_add(&stats->acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended) __atomic_fetch_add(&stats->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->wait_total_ns, wait_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->wait_histogram[bucket_of(wait_ns)], 1, __ATOMIC_RELAXED);
+    update_max(&stats->wait_max_ns, wait_ns);
+
+    mutex->acquired_ns = now;
+    mutex->command = command;
+}
+
+// A trylock that backed off, called without the mutex
+static void record_busy(ProfiledMutex* mutex) {
+    LockProfile* profile = mutex->profile;
+    register_profile(profile);
+
+    LockCommandStats* stats = &profile->commands[current_command()];
+    __atomic_fetch_add(&stats->contended, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->busy, 1, __ATOMIC_RELAXED);
+}
+
+// Called with the mutex still held
+static void record_release(ProfiledMutex* mutex) {
+    uint64_t hold_ns = monotonic_ns() - mutex->acquired_ns;
+    LockCommandStats* stats = &mutex->profile->commands[mutex->command];
+    __atomic_fetch_add(&stats->holds, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->hold_total_ns, hold_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->hold_histogram[bucket_of(hold_ns)], 1, __ATOMIC_RELAXED);
+    update_max(&stats->hold_max_ns, hold_ns);
+}
+
+static void print_report(void) {
+    char* report = formatLockProfiles();
+    if (report) {
+        fputs(report, stderr);
+        fflush(stderr);
+        free(report);
+    }
+}
+
+// Takes the report signals synchronously, so printing isn't limited to
+// async-signal-safe calls
+static void* report_thread(void* arg) {
+    sigset_t* signals = (sigset_t*)arg;
+    int sig;
+    while (sigwait(signals, &sig) == 0) {
+        print_report();
+        if (sig != SIGUSR1) exit(0);
+    }
+    return NULL;
+}
+
+bool startLockProfiling(void) {
+    const char* value = getenv("LOCK_PROFILE");
+    if (!value || !*value || strcmp(value, "0") == 0) return false;
+
+    pthread_key_create(&command_key, NULL);
+
+    // Threads started from here on inherit the mask and leave these to report_thread
+    static sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, report_thread, &signals) != 0) {
+        pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+        return false;
+    }
+    pthread_detach(tid);
+    profiling = true;
+    return true;
+}
+
+void setLockCommand(CommandType type) {
+    if (!profiling) return;
+    pthread_setspecific(command_key, (void*)(intptr_t)type);
+}
+
+void initProfiledMutex(ProfiledMutex* mutex, LockProfile* profile) {
+    pthread_mutex_init(&mutex->mutex, NULL);
+    mutex->profile = profile;
+    mutex->acquired_ns = 0;
+    mutex->command = 0;
+}
+
+void destroyProfiledMutex(ProfiledMutex* mutex) {
+    pthread_mutex_destroy(&mutex->mutex);
+}
+
+void lockProfiled(ProfiledMutex* mutex) {
+    if (!profiling) {
+        pthread_mutex_lock(&mutex->mutex);
+        return;
+    }
+    // The clock is read again only when the lock was taken
+    uint64_t start = monotonic_ns();
+    bool contended = pthread_mutex_trylock(&mutex->mutex) != 0;
+    uint64_t now = start;
+    if (contended) {
+        pthread_mutex_lock(&mutex->mutex);
+        now = monotonic_ns();
+    }
+    record_acquire(mutex, contended, now - start, now);
+}
+
+int tryLockProfiled(ProfiledMutex* mutex) {
+    int result = pthread_mutex_trylock(&mutex->mutex);
+    if (!profiling) return result;
+    if (result == 0) {
+        record_acquire(mutex, false, 0, monotonic_ns());
+    } else if (result == EBUSY) {
+        record_busy(mutex);
+    }
+    return result;
+}
+
+void unlockProfiled(ProfiledMutex* mutex) {
+    if (profiling) record_release(mutex);
+    pthread_mutex_unlock(&mutex->mutex);
+}
+
+void waitProfiled(pthread_cond_t* cond, ProfiledMutex* mutex) {
+    if (!profiling) {
+        pthread_cond_wait(cond, &mutex->mutex);
+        return;
+    }
+    record_release(mutex);
+    int command = mutex->command;
+    pthread_cond_wait(cond, &mutex->mutex);
+    mutex->acquired_ns = monotonic_ns();
+    mutex->command = command;
+}
+
+static void append(char** buf, size_t* size, size_t* used, const char* format, ...) {
+    if (!*buf) return;
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(*buf + *used, *size - *used, format, args);
+        va_end(args);
+        if (written < 0) return;
+        if (*used + (size_t)written < *size) {
+            *used += (size_t)written;
+            return;
+        }
+        char* grown = realloc(*buf, *size * 2);
+        if (!grown) {
+            free(*buf);
+            *buf = NULL;
+            return;
+        }
+        *buf = grown;
+        *size *= 2;
+    }
+}
+
+// Upper bound of the bucket holding the given percentile, never past the max
+static uint64_t percentile_ns(const uint64_t* histogram, uint64_t count, double percent, uint64_t max) {
+    uint64_t target = (uint64_t)(count * percent / 100.0);
+    uint64_t seen = 0;
+    uint64_t bound = 1ULL << (LOCK_HISTOGRAM_BUCKETS - 1);
+    for (int i = 0; i < LOCK_HISTOGRAM_BUCKETS; i++) {
+        seen += __atomic_load_n(&histogram[i], __ATOMIC_RELAXED);
+        if (seen > target) {
+            bound = i == 0 ? 0 : (1ULL << i);
+            break;
+        }
+    }
+    return bound < max ? bound : max;
+}
+
+char* formatLockProfiles(void) {
+    size_t size = 4096;
+    size_t used = 0;
+    char* buf = malloc(size);
+    if (!buf) return NULL;
+    buf[0] = '\0';
+
+    if (!profiling) {
+        append(&buf, &size, &used, "Lock profiling is off, start the server with LOCK_PROFILE=1\n");
+        return buf;
+    }
+
+    // Times in microseconds, percentiles are histogram bucket bounds
+    pthread_mutex_lock(&registry_mutex);
+    for (LockProfile* profile = registry; profile; profile = profile->next) {
+        for (int c = 0; c < LOCK_COMMANDS; c++) {
+            LockCommandStats* stats = &profile->commands[c];
+            uint64_t count = __atomic_load_n(&stats->acquisitions, __ATOMIC_RELAXED);
+            uint64_t busy = __atomic_load_n(&stats->busy, __ATOMIC_RELAXED);
+            if (count == 0 && busy == 0) continue;
+            uint64_t wait_max = __atomic_load_n(&stats->wait_max_ns, __ATOMIC_RELAXED);
+            uint64_t hold_max = __atomic_load_n(&stats->hold_max_ns, __ATOMIC_RELAXED);
+            uint64_t holds = __atomic_load_n(&stats->holds, __ATOMIC_RELAXED);
+            append(&buf, &size, &used,
+                   "%s %s: %llu acquired, %llu contended (%llu trylocks busy), "
+                   "wait avg %.1f p99 %.1f max %.1f us, hold avg %.1f p99 %.1f max %.1f us\n",
+                   profile->name, command_names[c],
+                   (unsigned long long)count,
+                   (unsigned long long)__atomic_load_n(&stats->contended, __ATOMIC_RELAXED),
+                   (unsigned long long)busy,
+                   count ? __atomic_load_n(&stats->wait_total_ns, __ATOMIC_RELAXED) / 1000.0 / count : 0.0,
+                   percentile_ns(stats->wait_histogram, count, 99.0, wait_max) / 1000.0,
+                   wait_max / 1000.0,
+                   holds ? __atomic_load_n(&stats->hold_total_ns, __ATOMIC_RELAXED) / 1000.0 / holds : 0.0,
+                   percentile_ns(stats->hold_histogram, holds, 99.0, hold_max) / 1000.0,
+                   hold_max / 1000.0);
+        }
+    }
+    pthread_mutex_unlock(&registry_mutex);
+    return buf;
+}
@@ -0,0 +1,70 @@
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "command.h"
+
+// Lock profiling. A ProfiledMutex is a pthread mutex that, once
+// startLockProfiling() turned profiling on, records how long threads waited
+// for it and held it, split by the command the thread was running. Mutexes
+// sharing a LockProfile are counted together, e.g. the write locks of every
+// graph. With profiling off a lock costs one extra branch.
+
+#define LOCK_COMMANDS (CMD_STATS + 1)
+#define LOCK_HISTOGRAM_BUCKETS 40   // bucket i counts times below 2^i ns
+
+typedef struct {
+    uint64_t acquisitions;
+    uint64_t contended;        // the lock was taken when asked for, busy included
+    uint64_t busy;             // tryLockProfiled found it taken and gave up
+    uint64_t wait_total_ns;
+    uint64_t wait_max_ns;
+    uint64_t holds;            // more than acquisitions when waitProfiled splits a hold
+    uint64_t hold_total_ns;
+    uint64_t hold_max_ns;
+    uint64_t wait_histogram[LOCK_HISTOGRAM_BUCKETS];
+    uint64_t hold_histogram[LOCK_HISTOGRAM_BUCKETS];
+} LockCommandStats;
+
+typedef struct LockProfile {
+    const char* name;
+    int registered;
+    struct LockProfile* next;
+    LockCommandStats commands[LOCK_COMMANDS];
+} LockProfile;
+
+#define LOCK_PROFILE_INITIALIZER(name) { name, 0, NULL, {{0}} }
+
+typedef struct {
+    pthread_mutex_t mutex;
+    LockProfile* profile;
+    uint64_t acquired_ns;   // written by the holder only
+    int command;
+} ProfiledMutex;
+
+#define PROFILED_MUTEX_INITIALIZER(profile) { PTHREAD_MUTEX_INITIALIZER, profile, 0, 0 }
+
+// Turns profiling on when LOCK_PROFILE is set to something other than 0 and
+// returns whether it did. Then SIGUSR1 prints the report to stderr, and
+// SIGINT/SIGTERM print it and exit. Call from main before starting threads.
+bool startLockProfiling(void);
+
+// Tells the locks which command the calling thread runs from now on
+void setLockCommand(CommandType type);
+
+void initProfiledMutex(ProfiledMutex* mutex, LockProfile* profile);
+void destroyProfiledMutex(ProfiledMutex* mutex);
+void lockProfiled(ProfiledMutex* mutex);
+// Returns 0 if it took the lock, like pthread_mutex_trylock
+int tryLockProfiled(ProfiledMutex* mutex);
+void unlockProfiled(ProfiledMutex* mutex);
+// pthread_cond_wait on the mutex, the time asleep counts as neither wait nor hold
+void waitProfiled(pthread_cond_t* cond, ProfiledMutex* mutex);
+
+// Returns the report as a malloc'ed string: for every lock and command that
+// used it, acquisitions, contended acquisitions, and wait and hold times
+char* formatLockProfiles(void);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdbool.h>
+
+// Opens a listening TCP socket on port, returns -1 on failure.
+// With reuseport set, several sockets can bind the same port and the kernel
+// spreads incoming connections across them.
+int openListener(const char* port, int backlog, bool reuseport);
+
+#endif
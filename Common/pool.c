@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdlib.h>
+#include <pthread.h>
+#include "pool.h"
+#include "affinity.h"
+
+typedef struct {
+    taskFunc func;
+    void* arg;
+} Task;
+
+struct ThreadPool {
+    pthread_t* threads;
+    int thread_count;
+
+    // Ring buffer of queued tasks
+    Task* tasks;
+    int capacity;
+    int head;
+    int count;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    bool stopping;
+
+    const char* cpus_var;   // NULL leaves workers unpinned
+    int started;            // workers that picked their CPU
+};
+
+static void* worker_loop(void* arg) {
+    ThreadPool* pool = (ThreadPool*)arg;
+
+    if (pool->cpus_var) {
+        pinThread(pool->cpus_var, __atomic_fetch_add(&pool->started, 1, __ATOMIC_RELAXED));
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    while (1) {
+        while (pool->count == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->not_empty, &pool->mutex);
+        }
+        if (pool->count == 0) break;  // stopping and drained
+
+        Task task = pool->tasks[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pthread_cond_signal(&pool->not_full);
+
+        pthread_mutex_unlock(&pool->mutex);
+        task.func(task.arg);
+        pthread_mutex_lock(&pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+ThreadPool* createThreadPool(int threads, int queue_depth) {
+    return createPinnedThreadPool(threads, queue_depth, NULL);
+}
+
+ThreadPool* createPinnedThreadPool(int threads, int queue_depth, const char* cpus_var) {
+    if (threads < 1 || queue_depth < 1) return NULL;
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+
+    pool->tasks = malloc(queue_depth * sizeof(Task));
+    pool->threads = malloc(threads * sizeof(pthread_t));
+    if (!pool->tasks || !pool->threads) {
+        free(pool->tasks);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pool->capacity = queue_depth;
+    pool->cpus_var = cpus_var;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_loop, pool) != 0) break;
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        destroyThreadPool(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+static void push_task(ThreadPool* pool, taskFunc func, void* arg) {
+    int tail = (pool->head + pool->count) % pool->capacity;
+    pool->tasks[tail].func = func;
+    pool->tasks[tail].arg = arg;
+    pool->count++;
+    pthread_cond_signal(&pool->not_empty);
+}
+
+int submitTask(ThreadPool* pool, taskFunc func, void* arg) {
+    if (!pool || !func) return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->count == pool->capacity && !pool->stopping) {
+        pthread_cond_wait(&pool->not_full, &pool->mutex);
+    }
+    if (pool->stopping) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+    push_task(pool, func, arg);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+int trySubmitTask(ThreadPool* pool, taskFunc func, void* arg) {
+    if (!pool || !func) return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->count == pool->capacity || pool->stopping) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+    push_task(pool, func, arg);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+int getPendingTasks(ThreadPool* pool) {
+    pthread_mutex_lock(&pool->mutex);
+    int count = pool->count;
+    pthread_mutex_unlock(&pool->mutex);
+    return count;
+}
+
+void destroyThreadPool(ThreadPool* pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_cond_broadcast(&pool->not_full);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->not_full);
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool->tasks);
+    free(pool);
+}
@@ -0,0 +1,28 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+
+typedef void (*taskFunc)(void* arg);
+typedef struct ThreadPool ThreadPool;
+
+// Starts threads workers sharing a queue of at most queue_depth tasks
+ThreadPool* createThreadPool(int threads, int queue_depth);
+
+// Same, each worker pinned round robin to the CPUs listed in the environment
+// variable cpus_var (see affinity.h)
+ThreadPool* createPinnedThreadPool(int threads, int queue_depth, const char* cpus_var);
+
+// Queues func(arg) for a worker, waiting while the queue is full
+int submitTask(ThreadPool* pool, taskFunc func, void* arg);
+
+// Queues func(arg) for a worker, returns -1 at once if the queue is full
+int trySubmitTask(ThreadPool* pool, taskFunc func, void* arg);
+
+// Returns the number of tasks waiting for a worker
+int getPendingTasks(ThreadPool* pool);
+
+// Runs the tasks already queued, then stops and frees the pool
+void destroyThreadPool(ThreadPool* pool);
+
+#endif
@@ -0,0 +1,217 @@
+#define _POSIX_C_SOURCE 200112L
+#include "session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include "command.h"
+#include "lockprof.h"
+
+// One connection being served
+typedef struct {
+    int fd;
+    const SessionConfig* config;
+    LineReader reader;
+    Graph* graph;
+    int burst;   // commands received since the client last caught up
+} Session;
+
+// Sends a status line, with its NUL when the server's protocol has one
+static void reply(Session* session, const char* msg) {
+    send(session->fd, msg, strlen(msg) + (session->config->nul_replies ? 1 : 0), 0);
+}
+
+// Answers Busy, the same bytes on every server
+static void reply_busy(Session* session) {
+    send(session->fd, BUSY_REPLY, BUSY_REPLY_LEN, 0);
+}
+
+// Sends text as is, for formatted replies that never carried a NUL
+static void reply_text(Session* session, const char* text) {
+    send(session->fd, text, strlen(text), 0);
+}
+
+// Reads n point lines for Newgraph into a private buffer, returns false if the
+// client disconnected. The graph is replaced in one step once every point is in,
+// so other clients never see part of it, and a bad line rejects the whole graph.
+static bool receive_graph(Session* session, int n) {
+    Point* points;
+    reply(session, "Ready to receive points\n");
+
+    int result = readPoints(&session->reader, session->fd, n, &points);
+    if (result < 0) return false;
+    if (result == POINTS_INVALID) {
+        reply(session, "Invalid point format\n");
+        return true;
+    }
+    if (result == POINTS_NO_MEMORY) {
+        reply(session, "Memory allocation failed\n");
+        return true;
+    }
+
+    if (setGraphPoints(session->graph, points, n) != 0) {
+        reply(session, "Memory allocation failed\n");
+        return true;
+    }
+    reply(session, "Graph created successfully\n");
+    return true;
+}
+
+// Replies with the lock profile report
+static void send_lock_stats(Session* session) {
+    char* report = formatLockProfiles();
+    if (!report) {
+        reply(session, "Memory allocation failed\n");
+        return;
+    }
+    reply_text(session, report);
+    reply_text(session, "End of stats\n");
+    free(report);
+}
+
+static void hull(Session* session) {
+    const SessionConfig* config = session->config;
+    double area = 0.0;
+
+    if (config->hulls && !tryAdmit(config->hulls)) {
+        reply_busy(session);
+        return;
+    }
+    int n = graphHullArea(session->graph, &area);
+    if (config->hulls) releaseAdmission(config->hulls);
+
+    if (n == 0 && !config->empty_hull_area) {
+        reply(session, "No points in graph\n");
+    } else {
+        char res[50];
+        snprintf(res, sizeof(res), "Area: %.1f\n", area);
+        reply_text(session, res);
+    }
+    if (config->on_hull) config->on_hull(session->graph);
+}
+
+// True once everything the client sent has been read and taken as commands,
+// i.e. no line, partial line or unread byte is waiting behind this one
+static bool caught_up(Session* session) {
+    int unread = 0;
+    if (session->reader.start != session->reader.end) return false;
+    return ioctl(session->fd, FIONREAD, &unread) == 0 && unread == 0;
+}
+
+// Counts the command into the client's burst and returns whether it is past
+// the pipelining limit. The first max_pending + 1 commands of a burst (the
+// one served and max_pending behind it) are served and the newer ones get
+// Busy; the burst ends once the client has nothing more waiting.
+static bool over_pending_limit(Session* session, const Command* cmd) {
+    int max_pending = session->config->max_pending;
+    if (max_pending == 0 || cmd->type == CMD_NEWGRAPH) return false;
+
+    bool over = ++session->burst > max_pending + 1;
+    if (caught_up(session)) session->burst = 0;
+    return over;
+}
+
+// Runs one command, returns false if the client disconnected
+static bool dispatch(Session* session, const Command* cmd) {
+    switch (cmd->type) {
+    case CMD_NEWGRAPH:
+        if (session->config->newgraph_clears) {
+            if (setGraphPoints(session->graph, NULL, 0) != 0) {
+                reply(session, "Memory allocation failed\n");
+            } else {
+                reply(session, "Ready to receive points\n");
+            }
+        } else if (cmd->valid) {
+            return receive_graph(session, cmd->n);
+        } else {
+            reply(session, "Invalid Newgraph command\n");
+        }
+        break;
+    case CMD_CH:
+        hull(session);
+        break;
+    case CMD_NEWPOINT:
+        if (!cmd->valid) {
+            reply(session, "Invalid Newpoint command\n");
+        } else if (addGraphPoint(session->graph, cmd->x, cmd->y) == 0) {
+            reply(session, "Point added\n");
+        } else {
+            reply(session, "Max points reached\n");
+        }
+        break;
+    case CMD_REMOVEPOINT:
+        if (cmd->valid) {
+            bool found = removeGraphPoint(session->graph, cmd->x, cmd->y);
+            reply(session, found ? "Point removed\n" : "Point not found\n");
+        } else {
+            reply(session, "Invalid Removepoint command\n");
+        }
+        break;
+    case CMD_USE:
+        if (cmd->valid) {
+            Graph* graph;
+            int result = findGraph(cmd->name, &graph);
+            if (result == GRAPH_TOO_MANY) {
+                reply(session, "Too many graphs\n");
+                break;
+            }
+            if (!graph) {
+                reply(session, "Memory allocation failed\n");
+                break;
+            }
+            session->graph = graph;
+            char res[GRAPH_NAME_MAX + 16];
+            snprintf(res, sizeof(res), "Using graph %s\n", cmd->name);
+            reply_text(session, res);
+        } else {
+            reply(session, "Invalid Use command\n");
+        }
+        break;
+    case CMD_STATS:
+        if (session->config->lock_stats) {
+            send_lock_stats(session);
+            break;
+        }
+        // fall through
+    default:
+        reply(session, "Unknown command\n");
+        break;
+    }
+    return true;
+}
+
+void serveSession(int client_fd, const SessionConfig* config) {
+    Session session;
+    Command cmd;
+    char* line;
+    size_t len;
+    bool open = true;
+
+    session.fd = client_fd;
+    session.config = config;
+    session.graph = getGraph(DEFAULT_GRAPH);
+    session.burst = 0;
+    initLineReader(&session.reader);
+    if (!session.graph) {
+        reply(&session, "Memory allocation failed\n");
+        close(client_fd);
+        return;
+    }
+
+    while (open && (line = readLine(&session.reader, client_fd, &len)) != NULL) {
+        parseCommand(line, len, &cmd);
+        setLockCommand(cmd.type);
+
+        // Newgraph is never turned away, the lines behind it are its points
+        if (over_pending_limit(&session, &cmd)) {
+            reply_busy(&session);
+            continue;
+        }
+
+        open = dispatch(&session, &cmd);
+    }
+
+    close(client_fd);
+}
@@ -0,0 +1,23 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdbool.h>
+#include "graph.h"
+#include "admission.h"
+
+// The per-connection command loop shared by the threaded servers (Q7-Q10).
+// What differs between them is described by a SessionConfig.
+typedef struct {
+    bool nul_replies;       // status replies go out with their terminating NUL (Q7-Q9)
+    bool newgraph_clears;   // Newgraph empties the graph instead of reading n points (Q10)
+    bool empty_hull_area;   // CH on an empty graph answers "Area: 0.0", not "No points in graph"
+    bool lock_stats;        // answer Stats with the lock profile report
+    Admission* hulls;       // CH computing at the same time, NULL for no limit
+    int max_pending;        // commands a client may pipeline behind the current one, 0 for no limit
+    void (*on_hull)(Graph* graph);   // called after every CH answered, may be NULL
+} SessionConfig;
+
+// Serves client_fd until the client disconnects, then closes it
+void serveSession(int client_fd, const SessionConfig* config);
+
+#endif // SESSION_H
@@ -2,86 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-
-// Structure to represent a 2D point with x and y coordinates
-typedef struct {
-    float x;
-    float y;
-} Point;
-
-/**
- * Determines the orientation of three ordered points (p, q, r)
- * Returns:
- * 0 - Colinear
- * 1 - Clockwise orientation
- * 2 - Counterclockwise orientation
- */
-int orientation(Point p, Point q, Point r) {
-    float val = (q.y - p.y) * (r.x - q.x) - (q.x - p.x) * (r.y - q.y);
-    if (fabs(val) < 1e-9) return 0;  // Colinear
-    return (val > 0) ? 1 : 2; // Clockwise or counterclockwise
-}
-
-/**
- * Comparison function for qsort() to sort points
- * First by x-coordinate, then by y-coordinate
- */
-int compare_points(const void *a, const void *b) {
-    Point *p1 = (Point *)a;
-    Point *p2 = (Point *)b;
-    if (p1->x != p2->x)
-        return (p1->x > p2->x) ? 1 : -1;
-    return (p1->y > p2->y) ? 1 : -1;
-}
-
-/**
- * Calculates the area of a polygon given its vertices
- * using the shoelace formula
- */
-float calculate_polygon_area(Point points[], int n) {
-    float area = 0.0;
-    for (int i = 0; i < n; i++) {
-        int j = (i + 1) % n;
-        area += (points[i].x * points[j].y) - (points[j].x * points[i].y);
-    }
-    return fabs(area) / 2.0;
-}
-
-/**
- * Computes the convex hull of a set of points using Graham's scan algorithm
- * Returns the number of points in the convex hull
- */
-int convex_hull(Point points[], int n, Point hull[]) {
-    // If there are less than 3 points, all points are part of the hull
-    if (n < 3) {
-        for (int i = 0; i < n; i++)
-            hull[i] = points[i];
-        return n;
-    }
-
-    // Sort points lexographically (first by x, then by y)
-    qsort(points, n, sizeof(Point), compare_points);
-
-    int k = 0; // Index for the hull array
-
-    // Build lower hull
-    for (int i = 0; i < n; i++) {
-        // Remove points that would create a clockwise turn
-        while (k >= 2 && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
-    }
-
-    // Build upper hull
-    for (int i = n-2, t = k+1; i >= 0; i--) {
-        // Remove points that would create a clockwise turn
-        while (k >= t && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
-    }
-
-    return k-1; // The first point is repeated at the end
-}
+#include "geom.h"
 
 int main() {
     int num_points;
@@ -10,104 +10,68 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include "graph.h"
+#include "command.h"
 #include "proactor.h"
+#include "affinity.h"
+#include "lockprof.h"
+#include "admission.h"
+#include "session.h"
 
 #define PORT "9034"
-#define BACKLOG 10
+#define BACKLOG 1024
 #define MAX_POINTS 1000
 #define AREA_THRESHOLD 100.0
 
-typedef struct
-{
-    double x, y;
-} Point;
-
-Point graph_points[MAX_POINTS];
-int point_count = 0;
-
-pthread_mutex_t graph_mutex = PTHREAD_MUTEX_INITIALIZER;
-
 double last_area = 0.0;
 bool triggered_above = false;
 bool triggered_below = false;
 
-pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
-
-void enqueue_signal()
-{
-    pthread_mutex_lock(&queue_mutex);
-    pthread_cond_signal(&queue_cond);
-    pthread_mutex_unlock(&queue_mutex);
-}
+// Admission limits, 0 for none. Whatever doesn't fit is answered Busy at once.
+Admission connections;   // connections being served
+Admission hulls;         // CH computing at the same time
 
-int orientation(Point p, Point q, Point r)
-{
-    double val = (q.y - p.y) * (r.x - q.x) -
-                 (q.x - p.x) * (r.y - q.y);
-    if (fabs(val) < 1e-9)
-        return 0;
-    return (val > 0) ? 1 : 2;
-}
+// Graph of the most recent CH, checked by the consumer thread
+Graph *watched_graph = NULL;
 
-int compare(const void *a, const void *b)
-{
-    Point *p1 = (Point *)a;
-    Point *p2 = (Point *)b;
-    if (p1->x != p2->x)
-        return (p1->x < p2->x) ? -1 : 1;
-    return (p1->y < p2->y) ? -1 : 1;
-}
+LockProfile queue_profile = LOCK_PROFILE_INITIALIZER("queue_mutex");
+ProfiledMutex queue_mutex = PROFILED_MUTEX_INITIALIZER(&queue_profile);
+pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
 
-int convex_hull(Point *points, int n, Point *hull)
+void enqueue_signal(Graph *graph)
 {
-    if (n < 3)
-        return 0;
-    qsort(points, n, sizeof(Point), compare);
-
-    int m = 0;
-    for (int i = 0; i < n; i++)
-    {
-        while (m >= 2 && orientation(hull[m - 2], hull[m - 1], points[i]) != 2)
-            m--;
-        hull[m++] = points[i];
-    }
-
-    for (int i = n - 2, t = m + 1; i >= 0; i--)
-    {
-        while (m >= t && orientation(hull[m - 2], hull[m - 1], points[i]) != 2)
-            m--;
-        hull[m++] = points[i];
-    }
-
-    return m - 1;
+    lockProfiled(&queue_mutex);
+    watched_graph = graph;
+    pthread_cond_signal(&queue_cond);
+    unlockProfiled(&queue_mutex);
 }
 
-double calculate_polygon_area(Point *polygon, int n)
-{
-    double area = 0.0;
-    for (int i = 0; i < n; i++)
-    {
-        Point p1 = polygon[i];
-        Point p2 = polygon[(i + 1) % n];
-        area += (p1.x * p2.y) - (p2.x * p1.y);
-    }
-    return fabs(area) / 2.0;
-}
+// How connections are served: Q10 replies without NULs, Newgraph only empties
+// the graph and every CH wakes the consumer. Limits are filled in by main.
+SessionConfig session = {
+    .newgraph_clears = true,
+    .empty_hull_area = true,
+    .lock_stats = true,
+    .hulls = &hulls,
+    .on_hull = enqueue_signal,
+};
 
 void *consumer_thread(void *arg)
 {
     (void)arg;
+    pinThread(CONSUMER_CPUS, 0);
     while (1)
     {
-        pthread_mutex_lock(&queue_mutex);
-        pthread_cond_wait(&queue_cond, &queue_mutex);
-        pthread_mutex_unlock(&queue_mutex);
+        lockProfiled(&queue_mutex);
+        waitProfiled(&queue_cond, &queue_mutex);
+        Graph *graph = watched_graph;
+        unlockProfiled(&queue_mutex);
+
+        if (!graph)
+            continue;
 
-        pthread_mutex_lock(&graph_mutex);
-        Point hull[MAX_POINTS];
-        int hsize = convex_hull(graph_points, point_count, hull);
-        double area = calculate_polygon_area(hull, hsize);
+        double area = 0.0;
+        graphHullArea(graph, &area);
 
         if (area >= AREA_THRESHOLD && !triggered_above)
         {
@@ -125,92 +89,62 @@ void *consumer_thread(void *arg)
         }
 
         last_area = area;
-        pthread_mutex_unlock(&graph_mutex);
     }
     return NULL;
 }
 
+// Turns a connection away without serving it, never blocks the accept thread
+void *reject_client(int client_fd)
+{
+    send(client_fd, BUSY_REPLY, BUSY_REPLY_LEN, MSG_DONTWAIT);
+    close(client_fd);
+    return NULL;
+}
+
 void *handle_client(int client_fd)
 {
-    FILE *client = fdopen(client_fd, "r+");
-    if (!client)
-    {
-        perror("fdopen");
-        close(client_fd);
-        return NULL;
-    }
     printf("New client connected on socket %d (Thread %lu)\n", client_fd, pthread_self());
     fflush(stdout);
-
-    char buffer[256];
-    while (fgets(buffer, sizeof(buffer), client))
-    {
-        if (strncmp(buffer, "Newgraph", 8) == 0)
-        {
-            pthread_mutex_lock(&graph_mutex);
-            point_count = 0;
-            pthread_mutex_unlock(&graph_mutex);
-            fprintf(client, "Ready to receive points\n");
-        }
-        else if (strncmp(buffer, "CH", 2) == 0)
-        {
-            pthread_mutex_lock(&graph_mutex);
-            Point hull[MAX_POINTS];
-            int hsize = convex_hull(graph_points, point_count, hull);
-            double area = calculate_polygon_area(hull, hsize);
-            fprintf(client, "Area: %.1f\n", area);
-            pthread_mutex_unlock(&graph_mutex);
-            enqueue_signal();
-        }
-        else if (strncmp(buffer, "Newpoint", 8) == 0)
-        {
-            double x, y;
-            sscanf(buffer + 8, "%lf,%lf", &x, &y);
-            pthread_mutex_lock(&graph_mutex);
-            if (point_count < MAX_POINTS)
-            {
-                graph_points[point_count++] = (Point){x, y};
-                fprintf(client, "Point added\n");
-            }
-            else
-            {
-                fprintf(client, "Max points reached\n");
-            }
-            pthread_mutex_unlock(&graph_mutex);
-        }
-        else if (strncmp(buffer, "Removepoint", 11) == 0)
-        {
-            double x, y;
-            sscanf(buffer + 11, "%lf,%lf", &x, &y);
-            pthread_mutex_lock(&graph_mutex);
-            bool found = false;
-            for (int i = 0; i < point_count; i++)
-            {
-                if (fabs(graph_points[i].x - x) < 1e-9 && fabs(graph_points[i].y - y) < 1e-9)
-                {
-                    graph_points[i] = graph_points[--point_count];
-                    found = true;
-                    break;
-                }
-            }
-            pthread_mutex_unlock(&graph_mutex);
-            fprintf(client, found ? "Point removed\n" : "Point not found\n");
-        }
-        else
-        {
-            fprintf(client, "Unknown command\n");
-        }
-        fflush(client);
-    }
-
-    fclose(client);
+    serveSession(client_fd, &session);
     return NULL;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     struct addrinfo hints, *servinfo, *p;
     int sockfd;
+    int max_connections = 0;
+    int max_hulls = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:C:p:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            max_connections = atoi(optarg);
+            break;
+        case 'C':
+            max_hulls = atoi(optarg);
+            break;
+        case 'p':
+            session.max_pending = atoi(optarg);
+            break;
+        default:
+            max_connections = -1;
+            break;
+        }
+    }
+    if (max_connections < 0 || max_hulls < 0 || session.max_pending < 0)
+    {
+        fprintf(stderr, "Usage: %s [-c max_connections] [-C max_hulls] [-p max_pending]\n", argv[0]);
+        exit(1);
+    }
+    initAdmission(&connections, max_connections);
+    initAdmission(&hulls, max_hulls);
+    setMaxGraphPoints(MAX_POINTS);
+
+    startLockProfiling();
 
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_UNSPEC;
@@ -247,7 +181,7 @@ int main()
 
     pthread_t consumer;
     pthread_create(&consumer, NULL, consumer_thread, NULL);
-    startProactor(sockfd, handle_client);
+    startProactorLimited(sockfd, handle_client, &connections, reject_client);
     pthread_join(consumer, NULL);
     return 0;
 }
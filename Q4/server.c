@@ -11,29 +11,18 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <stdbool.h>
+#include "graph.h"
+#include "command.h"
 
 #define PORT "9034"   // Port we're listening on
 #define BACKLOG 10    // Max connections waiting in queue
 
-// Structure for 2D point
-typedef struct {
-    float x;
-    float y;
-} Point;
-
-// Global graph state
-Point* graph_points = NULL;
-int num_points = 0;
-
 // Function declarations
-int orientation(Point p, Point q, Point r);
-int compare_points(const void *a, const void *b);
-float calculate_polygon_area(Point points[], int n);
-float convex_hull_array(Point points[], int n);
-void handle_newgraph(int n, int fd);
-void handle_newpoint(float x, float y);
-bool handle_removepoint(float x, float y);
-void handle_ch(int fd);
+void handle_newgraph(Graph* graph, int n, int fd, LineReader* reader);
+int handle_newpoint(Graph* graph, Coord x, Coord y);
+bool handle_removepoint(Graph* graph, Coord x, Coord y);
+void handle_ch(Graph* graph, int fd);
+Graph* handle_use(Graph* current, const char* name, int fd);
 void *get_in_addr(struct sockaddr *sa);
 int send_all(int fd, char *buf, int len);
 
@@ -61,146 +50,76 @@ int send_all(int fd, char *buf, int len) {
     return n==-1 ? -1 : 0;
 }
 
-// Orientation function (same as before)
-int orientation(Point p, Point q, Point r) {
-    float val = (q.y - p.y) * (r.x - q.x) - (q.x - p.x) * (r.y - q.y);
-    if (fabs(val) < 1e-9) return 0;
-    return (val > 0) ? 1 : 2;
-}
-
-// Comparison function for sorting points
-int compare_points(const void *a, const void *b) {
-    Point *p1 = (Point *)a;
-    Point *p2 = (Point *)b;
-    if (p1->x != p2->x)
-        return (p1->x > p2->x) ? 1 : -1;
-    return (p1->y > p2->y) ? 1 : -1;
-}
-
-// Calculate polygon area
-float calculate_polygon_area(Point points[], int n) {
-    float area = 0.0;
-    for (int i = 0; i < n; i++) {
-        int j = (i + 1) % n;
-        area += (points[i].x * points[j].y) - (points[j].x * points[i].y);
-    }
-    return fabs(area) / 2.0;
-}
-
-// Convex hull calculation
-float convex_hull_array(Point points[], int n) {
-    if (n < 3) {
-        return calculate_polygon_area(points, n);
-    }
-
-    qsort(points, n, sizeof(Point), compare_points);
-
-    Point* hull = (Point*)malloc(n * 2 * sizeof(Point));
-    int k = 0;
-
-    // Build lower hull
-    for (int i = 0; i < n; i++) {
-        while (k >= 2 && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
-    }
-
-    // Build upper hull
-    for (int i = n-2, t = k+1; i >= 0; i--) {
-        while (k >= t && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
-    }
+// Handle Newgraph command
+void handle_newgraph(Graph* graph, int n, int fd, LineReader* reader) {
+    Point* points;
 
-    float area = calculate_polygon_area(hull, k-1);
-    free(hull);
-    return area;
-}
+    // Send acknowledgment
+    send(fd, "Ready to receive points\n", 24, 0);
 
-// Handle Newgraph command
-void handle_newgraph(int n, int fd) {
-    // Free previous points if any
-    if (graph_points != NULL) {
-        free(graph_points);
-        graph_points = NULL;
+    // Read all n point lines, a bad one rejects the graph once they're consumed.
+    // On disconnect the previous graph stays.
+    int result = readPoints(reader, fd, n, &points);
+    if (result == POINTS_INVALID) {
+        send(fd, "Invalid point format\n", 21, 0);
+        return;
     }
-
-    num_points = n;
-    graph_points = (Point *)malloc(n * sizeof(Point));
-    if (!graph_points) {
+    if (result == POINTS_NO_MEMORY) {
         send(fd, "Memory allocation failed\n", 25, 0);
         return;
     }
+    if (result != POINTS_OK) return;
 
-    // Send acknowledgment
-    send(fd, "Ready to receive points\n", 24, 0);
-
-    // Read n points from client
-    for (int i = 0; i < n; i++) {
-        char buf[256];
-        int bytes_received = recv(fd, buf, sizeof(buf)-1, 0);
-        if (bytes_received <= 0) {
-            // Connection closed or error
-            free(graph_points);
-            graph_points = NULL;
-            num_points = 0;
-            return;
-        }
-        buf[bytes_received] = '\0';
-
-        // Parse point
-        float x, y;
-        if (sscanf(buf, "%f,%f", &x, &y) != 2) {
-            send(fd, "Invalid point format\n", 21, 0);
-            free(graph_points);
-            graph_points = NULL;
-            num_points = 0;
-            return;
-        }
-        graph_points[i].x = x;
-        graph_points[i].y = y;
+    // Publish the complete graph at once
+    if (setGraphPoints(graph, points, n) != 0) {
+        send(fd, "Memory allocation failed\n", 25, 0);
+        return;
     }
-
     send(fd, "Graph created successfully\n", 27, 0);
 }
 
 // Handle Newpoint command
-void handle_newpoint(float x, float y) {
-    num_points++;
-    graph_points = (Point *)realloc(graph_points, num_points * sizeof(Point));
-    graph_points[num_points - 1].x = x;
-    graph_points[num_points - 1].y = y;
+int handle_newpoint(Graph* graph, Coord x, Coord y) {
+    return addGraphPoint(graph, x, y);
 }
 
 // Handle Removepoint command
-bool handle_removepoint(float x, float y) {
-    for (int i = 0; i < num_points; i++) {
-        if (fabs(graph_points[i].x - x) < 1e-9 && fabs(graph_points[i].y - y) < 1e-9) {
-            // Shift points
-            for (int j = i; j < num_points - 1; j++) {
-                graph_points[j] = graph_points[j + 1];
-            }
-            num_points--;
-            graph_points = (Point *)realloc(graph_points, num_points * sizeof(Point));
-            return true;
-        }
-    }
-    return false;
+bool handle_removepoint(Graph* graph, Coord x, Coord y) {
+    return removeGraphPoint(graph, x, y);
 }
 
 // Handle CH command
-void handle_ch(int fd) {
-    if (num_points == 0) {
+void handle_ch(Graph* graph, int fd) {
+    double area;
+    if (graphHullArea(graph, &area) == 0) {
         send(fd, "No points in graph\n", 19, 0);
         return;
     }
 
-    float area = convex_hull_array(graph_points, num_points);
     char response[50];
     snprintf(response, sizeof(response), "Area: %.1f\n", area);
     send(fd, response, strlen(response), 0);
 }
 
+// Handle Use command, returns the selected graph (current if it can't be created)
+Graph* handle_use(Graph* current, const char* name, int fd) {
+    Graph* graph;
+    int result = findGraph(name, &graph);
+    if (result == GRAPH_TOO_MANY) {
+        send(fd, "Too many graphs\n", 16, 0);
+        return current;
+    }
+    if (!graph) {
+        send(fd, "Memory allocation failed\n", 25, 0);
+        return current;
+    }
+
+    char response[GRAPH_NAME_MAX + 16];
+    snprintf(response, sizeof(response), "Using graph %s\n", name);
+    send(fd, response, strlen(response), 0);
+    return graph;
+}
+
 // Main server function
 int main(void) {
     int sockfd, new_fd;  // Listen on sock_fd, new connection on new_fd
@@ -272,41 +191,49 @@ int main(void) {
             s, sizeof s);
         printf("server: got connection from %s\n", s);
 
-        // Handle new connection in a loop
-        while(1) {
-            char buf[256];
-            int bytes_received = recv(new_fd, buf, sizeof(buf)-1, 0);
-            if (bytes_received <= 0) {
-                // Connection closed or error
-                break;
-            }
-            buf[bytes_received] = '\0';
+        // Every connection starts on the default graph
+        Graph* graph = getGraph(DEFAULT_GRAPH);
+        if (!graph) {
+            send(new_fd, "Memory allocation failed\n", 25, 0);
+            close(new_fd);
+            continue;
+        }
 
+        // Handle new connection one line at a time
+        LineReader reader;
+        initLineReader(&reader);
+        char* line;
+        size_t len;
+        while ((line = readLine(&reader, new_fd, &len)) != NULL) {
             // Process command
-            if (strncmp(buf, "Newgraph", 8) == 0) {
-                int n;
-                if (sscanf(buf + 8, "%d", &n) == 1 && n > 0) {
-                    handle_newgraph(n, new_fd);
+            Command cmd;
+            parseCommand(line, len, &cmd);
+
+            switch (cmd.type) {
+            case CMD_NEWGRAPH:
+                if (cmd.valid) {
+                    handle_newgraph(graph, cmd.n, new_fd, &reader);
                 } else {
                     send(new_fd, "Invalid Newgraph command\n", 25, 0);
                 }
-            }
-            else if (strncmp(buf, "CH", 2) == 0) {
-                handle_ch(new_fd);
-            }
-            else if (strncmp(buf, "Newpoint", 8) == 0) {
-                float x, y;
-                if (sscanf(buf + 8, "%f,%f", &x, &y) == 2) {
-                    handle_newpoint(x, y);
-                    send(new_fd, "Point added\n", 12, 0);
+                break;
+            case CMD_CH:
+                handle_ch(graph, new_fd);
+                break;
+            case CMD_NEWPOINT:
+                if (cmd.valid) {
+                    if (handle_newpoint(graph, cmd.x, cmd.y) == 0) {
+                        send(new_fd, "Point added\n", 12, 0);
+                    } else {
+                        send(new_fd, "Max points reached\n", 19, 0);
+                    }
                 } else {
                     send(new_fd, "Invalid Newpoint command\n", 25, 0);
                 }
-            }
-            else if (strncmp(buf, "Removepoint", 11) == 0) {
-                float x, y;
-                if (sscanf(buf + 11, "%f,%f", &x, &y) == 2) {
-                    if (handle_removepoint(x, y)) {
+                break;
+            case CMD_REMOVEPOINT:
+                if (cmd.valid) {
+                    if (handle_removepoint(graph, cmd.x, cmd.y)) {
                         send(new_fd, "Point removed\n", 14, 0);
                     } else {
                         send(new_fd, "Point not found\n", 16, 0);
@@ -314,9 +241,17 @@ int main(void) {
                 } else {
                     send(new_fd, "Invalid Removepoint command\n", 28, 0);
                 }
-            }
-            else {
+                break;
+            case CMD_USE:
+                if (cmd.valid) {
+                    graph = handle_use(graph, cmd.name, new_fd);
+                } else {
+                    send(new_fd, "Invalid Use command\n", 20, 0);
+                }
+                break;
+            default:
                 send(new_fd, "Unknown command\n", 16, 0);
+                break;
             }
         }
 
@@ -324,6 +259,6 @@ int main(void) {
     }
 
     // Cleanup (though we'll likely never get here)
-    if (graph_points) free(graph_points);
+    destroyGraphs();
     return 0;
 }
\ No newline at end of file
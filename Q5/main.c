@@ -9,6 +9,7 @@ void handleClient(int fd) {
     ssize_t bytes = read(fd, buffer, sizeof(buffer)-1);
     
     if (bytes <= 0) {
+        removeFd(getCurrentReactor(), fd);
         close(fd);
         printf("Client disconnected\n");
         return;
@@ -1,113 +1,1645 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <sys/select.h>
+#include <sys/socket.h>
 #include <pthread.h>
+#include <time.h>
 #include "reactor.h"
 
-#define MAX_FDS 1024
+#ifdef __linux__
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "uring.h"
+#define HAVE_EPOLL 1
+#define HAVE_IO_URING 1
+#endif
 
+// make BACKEND=select|io_uring changes the default from epoll
+#if defined(REACTOR_USE_SELECT) || !defined(HAVE_EPOLL)
+#define DEFAULT_BACKEND REACTOR_BACKEND_SELECT
+#elif defined(REACTOR_USE_IO_URING)
+#define DEFAULT_BACKEND REACTOR_BACKEND_IO_URING
+#else
+#define DEFAULT_BACKEND REACTOR_BACKEND_EPOLL
+#endif
+
+#define INITIAL_FDS 1024
+#define MAX_EVENTS 256
+
+// reactorSend refuses to queue more than this for one fd
+#define MAX_OUTPUT (16 * 1024 * 1024)
+
+// Matches any generation, select events carry none
+#define ANY_GENERATION 0xffffffffu
+
+// Generations keep to 31 bits so an event tag never has the top bit set
+#define GENERATION_MASK 0x7fffffffu
+
+// Tags events of the wakeup fd, no registration has the top bit set
+#define WAKE_TAG ((1ULL << 63) | 1)
+
+// io_uring backend: ring sizes, and the receive buffers each reactor lends
+// the multishot recvs of its completion handlers
+#define URING_ENTRIES 1024
+#define URING_CQ_ENTRIES 16384
+#define RECV_BUFFERS 256
+#define RECV_BUFFER_SIZE 4096
+#define RECV_BUFFER_GROUP 0
+
+// A paused completion handler keeps receiving until this much waits for it,
+// then its recv is cancelled and TCP holds the peer back
+#define MAX_PAUSED_INPUT (64 * 1024)
+
+// The low bits of a ring request's user_data say what it is, the rest
+// points at its Stream. Requests without a stream carry the bits alone.
+#define REQUEST_RECV 1       // the multishot recv, or accept for a listener
+#define REQUEST_SEND 2
+#define REQUEST_MASK 3
+#define URING_EPOLL_TAG 1    // the poll on the epoll set
+#define URING_IGNORE_TAG 2   // cancellations
+#define URING_WAKE_TAG 3     // the read of the wakeup fd
+
+// Last reactor created, what getCurrentReactor returns outside reactor threads
 static Reactor* currentReactor = NULL;
 
+// Reactor whose loop runs on this thread
+static _Thread_local Reactor* loopReactor = NULL;
+
+static const char* backend_names[] = { "select", "epoll", "io_uring" };
+
+// Bytes reactorSend could not write yet, data[head..tail) is pending
+typedef struct {
+    char* data;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} OutputQueue;
+
+// Which callback a handler holds
+enum {
+    HANDLER_NONE,      // the slot is free
+    HANDLER_FD,        // reactorFunc from addFd
+    HANDLER_EVENTS,    // reactorEventFunc from addFdEvents
+    HANDLER_CONTEXT,   // reactorContextFunc from addFdContext
+    HANDLER_STREAM     // completion handler, ctx is its Stream
+};
+
+// 32 bytes, two to a cache line. The output queue lives apart and is only
+// allocated once a send backs up, most fds never need one.
+typedef struct {
+    union {
+        reactorFunc fd;
+        reactorEventFunc events;
+        reactorContextFunc context;
+    } func;
+    void* ctx;
+    OutputQueue* output;
+    // Bumped by removeFd, events carry it so a stale one can be told apart
+    uint32_t generation;
+    uint8_t kind;       // HANDLER_*
+    uint8_t events;     // interest asked for by the caller
+    uint8_t interest;   // interest registered with the backend
+} Handler;
+
+#ifdef HAVE_IO_URING
+// An fd whose I/O the ring does, from registerCompletionHandler or
+// addAcceptHandler. The kernel can hold its requests past removeFd, so the
+// loop frees it once they are all back.
+typedef struct Stream {
+    int fd;
+    bool accepting;   // a listener, completions are new connections
+    union {
+        reactorRecvFunc recv;
+        reactorAcceptFunc accept;
+    } func;
+    void* ctx;
+    int requests;         // requests the kernel holds
+    bool receiving;       // the multishot recv (or accept) is armed
+    bool cancelling;      // and its cancellation is on the way
+    bool sending;
+    bool send_cancelled;
+    bool paused;          // setFdEvents dropped REACTOR_EVENT_READ
+    bool ended;           // the peer closed or the connection failed
+    bool ended_told;      // the handler heard about it
+    bool removed;         // removeFd ran
+    bool queued;          // on the reactor's flush list
+    int error;            // errno of a failed send, reactorSend fails with it
+    OutputQueue output;   // bytes reactorSend queued since the last send went out
+    OutputQueue sent;     // bytes the kernel is sending, untouched until it's done
+    OutputQueue input;    // bytes received that the handler didn't take yet
+    struct Stream* next_flush;
+    struct Stream* prev;  // every stream of the reactor, for stopReactor
+    struct Stream* next;
+} Stream;
+#endif
+
+// Callback handed to the loop by another thread
+typedef struct Posted {
+    postedFunc func;
+    void* arg;
+    struct Posted* next;
+} Posted;
+
 struct Reactor {
-    fd_set fds;
-    reactorFunc handlers[MAX_FDS];
-    int max_fd;
+    ReactorBackend backend;
+    Handler* handlers;   // indexed by fd, grows on demand
+    int capacity;
+    pthread_mutex_t mutex;
     int running;
     pthread_t thread;
+    int watched;   // fds with a handler, read without the mutex for load balancing
+    uint64_t now;  // loop clock in ms, refreshed after every wait
+    TimerWheel timers;
+
+    // Other threads write here to cut the loop's wait short.
+    // One eventfd on Linux (both ends the same), a pipe elsewhere.
+    int wake_read;
+    int wake_write;
+    int wake_pending;  // a wakeup is already on its way
+
+    // Callbacks from postToReactor, in the order they were posted
+    Posted* posted_head;
+    Posted* posted_tail;
+
+    // Written only by the loop thread, read with getReactorStats
+    ReactorStats stats;
+
+    // select backend
+    fd_set read_fds;
+    fd_set write_fds;
+    int max_fd;
+
+    // epoll backend, and the io_uring one for fds registered with addFd*
+    int epoll_fd;
+
+#ifdef HAVE_IO_URING
+    // io_uring backend, only the loop thread touches the rings
+    Uring ring;
+    UringBuffers buffers;
+    bool polling;          // a poll on epoll_fd is armed
+    bool reading_wake;     // a read of wake_read is armed
+    uint64_t wake_value;   // where that read puts the eventfd count
+    Stream* flush_head;    // streams with requests to submit or input to hand over
+    Stream* flush_tail;
+    Stream* streams;
+#endif
 };
 
-static void* reactorLoop(void* arg) {
-    Reactor* reactor = (Reactor*)arg;
-    
-    while (reactor->running) {
-        fd_set read_fds = reactor->fds;
-        struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
-        
-        int activity = select(reactor->max_fd + 1, &read_fds, NULL, NULL, &timeout);
-        
-        if (activity < 0) {
-            perror("select error");
-            continue;
+struct ReactorGroup {
+    Reactor** reactors;
+    int count;
+    ReactorBalance balance;
+    unsigned next;   // round-robin cursor
+};
+
+// Identifies a registration in epoll events
+static uint64_t event_tag(int fd, uint32_t generation) {
+    return ((uint64_t)generation << 32) | (uint32_t)fd;
+}
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// The loop thread is the only writer, relaxed stores keep readers race free
+static void stat_add(uint64_t* counter, uint64_t value) {
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static void stat_max(uint64_t* counter, uint64_t value) {
+    if (value > *counter) __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+static int histogram_bucket(uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+    while (us > 0 && bucket < REACTOR_STATS_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+// Accounts one wait on the backend and the events it returned
+static void record_wait(Reactor* reactor, uint64_t waited, uint64_t ready) {
+    ReactorStats* stats = &reactor->stats;
+    stat_add(&stats->iterations, 1);
+    stat_add(&stats->wait_ns, waited);
+    stat_max(&stats->max_wait_ns, waited);
+    stat_add(&stats->ready, ready);
+    stat_max(&stats->max_ready, ready);
+}
+
+// Accounts one callback that ran since start_ns
+static void record_callback(Reactor* reactor, uint64_t func, uint64_t start_ns) {
+    ReactorStats* stats = &reactor->stats;
+    uint64_t elapsed = monotonic_ns() - start_ns;
+
+    stat_add(&stats->busy_ns, elapsed);
+    if (elapsed > stats->longest_stall_ns) {
+        __atomic_store_n(&stats->longest_stall_ns, elapsed, __ATOMIC_RELAXED);
+        __atomic_store_n(&stats->longest_stall_func, func, __ATOMIC_RELAXED);
+    }
+
+    // A handful of distinct callbacks per reactor, a scan is enough
+    ReactorCallbackStats* slot = NULL;
+    for (uint64_t i = 0; i < stats->callback_count; i++) {
+        if (stats->callbacks[i].func == func) {
+            slot = &stats->callbacks[i];
+            break;
+        }
+    }
+    if (!slot) {
+        if (stats->callback_count == REACTOR_STATS_CALLBACKS) return;
+        slot = &stats->callbacks[stats->callback_count];
+        __atomic_store_n(&slot->func, func, __ATOMIC_RELAXED);
+        stat_add(&stats->callback_count, 1);
+    }
+
+    stat_add(&slot->calls, 1);
+    stat_add(&slot->total_ns, elapsed);
+    stat_max(&slot->max_ns, elapsed);
+    stat_add(&slot->histogram[histogram_bucket(elapsed)], 1);
+}
+
+// Grows the handler table to cover fd, called with the mutex held
+static int ensure_capacity(Reactor* reactor, int fd) {
+    if (fd < reactor->capacity) return 0;
+
+    int capacity = reactor->capacity;
+    while (capacity <= fd) capacity *= 2;
+
+    Handler* grown = realloc(reactor->handlers, capacity * sizeof(Handler));
+    if (!grown) return -1;
+    memset(grown + reactor->capacity, 0, (capacity - reactor->capacity) * sizeof(Handler));
+    reactor->handlers = grown;
+    reactor->capacity = capacity;
+    return 0;
+}
+
+static bool has_handler(const Handler* handler) {
+    return handler->kind != HANDLER_NONE;
+}
+
+// Interest the backend should watch: what the caller asked for, plus
+// writability while queued output is waiting
+static int wanted_interest(const Handler* handler) {
+    int interest = handler->events;
+    if (handler->output && handler->output->tail > handler->output->head) interest |= REACTOR_EVENT_WRITE;
+    return interest;
+}
+
+static void free_output(Handler* handler) {
+    if (!handler->output) return;
+    free(handler->output->data);
+    free(handler->output);
+    handler->output = NULL;
+}
+
+static int queue_output(OutputQueue* output, const char* buf, size_t len) {
+    size_t pending = output->tail - output->head;
+    if (pending + len > MAX_OUTPUT) return -1;
+
+    if (output->tail + len > output->capacity) {
+        // Slide the pending bytes to the front before growing
+        if (output->head > 0) {
+            memmove(output->data, output->data + output->head, pending);
+            output->head = 0;
+            output->tail = pending;
+        }
+        if (pending + len > output->capacity) {
+            size_t capacity = output->capacity ? output->capacity : 4096;
+            while (capacity < pending + len) capacity *= 2;
+            char* grown = realloc(output->data, capacity);
+            if (!grown) return -1;
+            output->data = grown;
+            output->capacity = capacity;
+        }
+    }
+
+    memcpy(output->data + output->tail, buf, len);
+    output->tail += len;
+    return 0;
+}
+
+// Writes as much queued output as the socket takes without blocking,
+// called with the mutex held. Returns -1 if the connection is broken.
+static int flush_output(OutputQueue* output, int fd) {
+    while (output->head < output->tail) {
+        ssize_t sent = send(fd, output->data + output->head, output->tail - output->head,
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        output->head += sent;
+    }
+    output->head = output->tail = 0;
+    return 0;
+}
+
+static void update_interest(Reactor* reactor, int fd);
+
+// Runs the handler for the events ready on fd. Pending output is written
+// here, the caller's handler only hears about the events it asked for.
+static void dispatch(Reactor* reactor, int fd, uint32_t generation, int ready) {
+    pthread_mutex_lock(&reactor->mutex);
+    if (fd >= reactor->capacity) {
+        pthread_mutex_unlock(&reactor->mutex);
+        return;
+    }
+
+    // An earlier handler in this batch may have removed fd, or even
+    // accepted a new connection that reused the number
+    Handler* slot = &reactor->handlers[fd];
+    if (!has_handler(slot) || slot->kind == HANDLER_STREAM || (generation != ANY_GENERATION && slot->generation != generation)) {
+        pthread_mutex_unlock(&reactor->mutex);
+        return;
+    }
+
+    if ((ready & REACTOR_EVENT_WRITE) && slot->output && slot->output->tail > slot->output->head) {
+        // A peer that stopped reading for good loses what was queued,
+        // its read handler sees the error next
+        if (flush_output(slot->output, fd) != 0) free_output(slot);
+        update_interest(reactor, fd);
+    }
+    Handler handler = *slot;
+    pthread_mutex_unlock(&reactor->mutex);
+
+    int events = ready & handler.events;
+    if (!events) return;
+
+    uint64_t start = monotonic_ns();
+    switch (handler.kind) {
+    case HANDLER_CONTEXT:
+        handler.func.context(fd, events, handler.ctx);
+        record_callback(reactor, (uint64_t)(uintptr_t)handler.func.context, start);
+        break;
+    case HANDLER_EVENTS:
+        handler.func.events(fd, events);
+        record_callback(reactor, (uint64_t)(uintptr_t)handler.func.events, start);
+        break;
+    default:
+        handler.func.fd(fd);
+        record_callback(reactor, (uint64_t)(uintptr_t)handler.func.fd, start);
+        break;
+    }
+}
+
+static uint64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void update_time(Reactor* reactor) {
+    __atomic_store_n(&reactor->now, monotonic_ms(), __ATOMIC_RELAXED);
+}
+
+// How long the loop may wait before the next timer needs it, -1 for no limit
+static int next_timeout(Reactor* reactor) {
+    pthread_mutex_lock(&reactor->mutex);
+    long timeout = timerWheelTimeout(&reactor->timers, monotonic_ms());
+    pthread_mutex_unlock(&reactor->mutex);
+
+    if (timeout > INT32_MAX) timeout = INT32_MAX;
+    return (int)timeout;
+}
+
+// Runs the timers that are due, each without the mutex held so they can
+// add or cancel timers and fds
+static void run_timers(Reactor* reactor) {
+    uint64_t now = monotonic_ms();
+    timerFunc func;
+    void* arg;
+
+    pthread_mutex_lock(&reactor->mutex);
+    while (timerWheelExpire(&reactor->timers, now, &func, &arg)) {
+        pthread_mutex_unlock(&reactor->mutex);
+        uint64_t start = monotonic_ns();
+        func(arg);
+        record_callback(reactor, (uint64_t)(uintptr_t)func, start);
+        pthread_mutex_lock(&reactor->mutex);
+    }
+    pthread_mutex_unlock(&reactor->mutex);
+}
+
+// Runs what other threads posted, each without the mutex held
+static void run_posted(Reactor* reactor) {
+    pthread_mutex_lock(&reactor->mutex);
+    Posted* posted = reactor->posted_head;
+    reactor->posted_head = reactor->posted_tail = NULL;
+    pthread_mutex_unlock(&reactor->mutex);
+
+    while (posted) {
+        Posted* next = posted->next;
+        uint64_t start = monotonic_ns();
+        posted->func(posted->arg);
+        record_callback(reactor, (uint64_t)(uintptr_t)posted->func, start);
+        free(posted);
+        posted = next;
+    }
+}
+
+static int wake_init(Reactor* reactor) {
+#ifdef __linux__
+    reactor->wake_read = reactor->wake_write = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    return reactor->wake_read == -1 ? -1 : 0;
+#else
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    reactor->wake_read = fds[0];
+    reactor->wake_write = fds[1];
+    return 0;
+#endif
+}
+
+static void wake_close(Reactor* reactor) {
+    close(reactor->wake_read);
+    if (reactor->wake_write != reactor->wake_read) close(reactor->wake_write);
+}
+
+// Interrupts the loop's wait so it sees a change made from another thread.
+// Wakeups coalesce, only the first since the loop last woke costs a write.
+static void wake_reactor(Reactor* reactor) {
+    if (loopReactor == reactor) return;
+    if (__atomic_exchange_n(&reactor->wake_pending, 1, __ATOMIC_ACQ_REL)) return;
+
+    uint64_t one = 1;
+    ssize_t written = write(reactor->wake_write, &one, sizeof(one));
+    (void)written;  // full means a wakeup is pending anyway
+}
+
+// Called by the loop once woken. Draining before clearing the flag means a
+// wakeup that raced with the drain was skipped only because its change,
+// made before it, is already visible to the loop's next pass.
+static void drain_wake(Reactor* reactor) {
+    char buf[64];
+    while (read(reactor->wake_read, buf, sizeof(buf)) > 0) {
+    }
+    __atomic_store_n(&reactor->wake_pending, 0, __ATOMIC_RELEASE);
+}
+
+static void selectLoop(Reactor* reactor) {
+    while (__atomic_load_n(&reactor->running, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&reactor->mutex);
+        fd_set read_fds = reactor->read_fds;
+        fd_set write_fds = reactor->write_fds;
+        int max_fd = reactor->max_fd;
+        pthread_mutex_unlock(&reactor->mutex);
+
+        FD_SET(reactor->wake_read, &read_fds);
+        if (reactor->wake_read > max_fd) max_fd = reactor->wake_read;
+
+        int timeout_ms = next_timeout(reactor);
+        struct timeval timeout = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+
+        uint64_t wait_start = monotonic_ns();
+        int activity = select(max_fd + 1, &read_fds, &write_fds, NULL, timeout_ms < 0 ? NULL : &timeout);
+        record_wait(reactor, monotonic_ns() - wait_start, activity > 0 ? (uint64_t)activity : 0);
+        update_time(reactor);
+
+        // EBADF means an fd was removed and closed after the sets were
+        // copied, the next pass copies them again
+        if (activity < 0 && errno != EINTR && errno != EBADF) perror("select error");
+
+        if (activity > 0 && FD_ISSET(reactor->wake_read, &read_fds)) {
+            drain_wake(reactor);
+            FD_CLR(reactor->wake_read, &read_fds);
         }
-        
-        if (activity == 0) { // Timeout
+
+        for (int fd = 0; activity > 0 && fd <= max_fd; fd++) {
+            int ready = 0;
+            if (FD_ISSET(fd, &read_fds)) ready |= REACTOR_EVENT_READ;
+            if (FD_ISSET(fd, &write_fds)) ready |= REACTOR_EVENT_WRITE;
+            if (ready) dispatch(reactor, fd, ANY_GENERATION, ready);
+        }
+
+        run_posted(reactor);
+        run_timers(reactor);
+    }
+}
+
+#ifdef HAVE_EPOLL
+// Runs the handlers of what epoll_wait returned, only the ready fds are visited
+static void dispatch_epoll(Reactor* reactor, const struct epoll_event* events, int count) {
+    for (int i = 0; i < count; i++) {
+        if (events[i].data.u64 == WAKE_TAG) {
+            drain_wake(reactor);
             continue;
         }
-        
-        for (int fd = 0; fd <= reactor->max_fd; fd++) {
-            if (FD_ISSET(fd, &read_fds) && reactor->handlers[fd]) {
-                reactor->handlers[fd](fd);
-            }
+
+        int fd = (int)(uint32_t)events[i].data.u64;
+        uint32_t generation = (uint32_t)(events[i].data.u64 >> 32);
+
+        // Errors and hangups wake both sides so the handler notices
+        int ready = 0;
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) ready |= REACTOR_EVENT_READ;
+        if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) ready |= REACTOR_EVENT_WRITE;
+        dispatch(reactor, fd, generation, ready);
+    }
+}
+
+static void epollLoop(Reactor* reactor) {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (__atomic_load_n(&reactor->running, __ATOMIC_ACQUIRE)) {
+        int timeout = next_timeout(reactor);
+        uint64_t wait_start = monotonic_ns();
+        int count = epoll_wait(reactor->epoll_fd, events, MAX_EVENTS, timeout);
+        record_wait(reactor, monotonic_ns() - wait_start, count > 0 ? (uint64_t)count : 0);
+        update_time(reactor);
+
+        if (count < 0 && errno != EINTR) perror("epoll_wait");
+        dispatch_epoll(reactor, events, count);
+
+        run_posted(reactor);
+        run_timers(reactor);
+    }
+}
+#endif
+
+#ifdef HAVE_IO_URING
+static size_t queued_bytes(const OutputQueue* queue) {
+    return queue->tail - queue->head;
+}
+
+static void release_queue(OutputQueue* queue) {
+    free(queue->data);
+    memset(queue, 0, sizeof(*queue));
+}
+
+// Drops the first count bytes of a queue, keeping its buffer
+static void consume_queue(OutputQueue* queue, size_t count) {
+    queue->head += count;
+    if (queue->head == queue->tail) queue->head = queue->tail = 0;
+}
+
+// Puts stream on the list the loop goes through before its next wait,
+// called with the mutex held
+static void queue_stream(Reactor* reactor, Stream* stream) {
+    if (stream->queued) return;
+    stream->queued = true;
+    stream->next_flush = NULL;
+    if (reactor->flush_tail) {
+        reactor->flush_tail->next_flush = stream;
+    } else {
+        reactor->flush_head = stream;
+    }
+    reactor->flush_tail = stream;
+    wake_reactor(reactor);
+}
+
+static uint64_t request_tag(Stream* stream, int request) {
+    return (uint64_t)(uintptr_t)stream | (uint64_t)request;
+}
+
+// Returns a free submission entry, submitting what is queued when the ring is full
+static struct io_uring_sqe* next_sqe(Reactor* reactor) {
+    struct io_uring_sqe* sqe = uringNextSqe(&reactor->ring);
+    if (!sqe) {
+        uringSubmit(&reactor->ring);
+        sqe = uringNextSqe(&reactor->ring);
+    }
+    return sqe;
+}
+
+// Queues the stream's multishot recv, or its multishot accept. Received data
+// lands in a buffer the kernel takes from the reactor's provided ring.
+static bool arm_receive(Reactor* reactor, Stream* stream) {
+    struct io_uring_sqe* sqe = next_sqe(reactor);
+    if (!sqe) return false;
+
+    sqe->fd = stream->fd;
+    if (stream->accepting) {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    } else {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RECV_BUFFER_GROUP;
+    }
+    sqe->user_data = request_tag(stream, REQUEST_RECV);
+    uringQueueSqe(&reactor->ring);
+    stream->receiving = true;
+    stream->requests++;
+    return true;
+}
+
+// Queues one send of what is left of the bytes the kernel holds, or of
+// everything queued since the last send once that one went out whole
+static bool arm_send(Reactor* reactor, Stream* stream) {
+    struct io_uring_sqe* sqe = next_sqe(reactor);
+    if (!sqe) return false;
+
+    if (queued_bytes(&stream->sent) == 0) {
+        OutputQueue drained = stream->sent;
+        stream->sent = stream->output;
+        stream->output = drained;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = stream->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(stream->sent.data + stream->sent.head);
+    sqe->len = (uint32_t)queued_bytes(&stream->sent);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = request_tag(stream, REQUEST_SEND);
+    uringQueueSqe(&reactor->ring);
+    stream->sending = true;
+    stream->requests++;
+    return true;
+}
+
+static bool cancel_request(Reactor* reactor, Stream* stream, int request) {
+    struct io_uring_sqe* sqe = next_sqe(reactor);
+    if (!sqe) return false;
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = request_tag(stream, request);
+    sqe->user_data = URING_IGNORE_TAG;
+    uringQueueSqe(&reactor->ring);
+    return true;
+}
+
+// Arms the poll that tells the loop the epoll set has ready fds. It is
+// one-shot and armed again after every wait, so fds a handler left ready
+// are reported again, like level-triggered epoll.
+static void arm_epoll(Reactor* reactor) {
+    struct io_uring_sqe* sqe = next_sqe(reactor);
+    if (!sqe) return;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = reactor->epoll_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_EPOLL_TAG;
+    uringQueueSqe(&reactor->ring);
+    reactor->polling = true;
+}
+
+// Arms the read of the wakeup eventfd. The ring waits on it directly, instead
+// of through the epoll set, and the read completing is what drains it.
+static void arm_wake(Reactor* reactor) {
+    struct io_uring_sqe* sqe = next_sqe(reactor);
+    if (!sqe) return;
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = reactor->wake_read;
+    sqe->addr = (uint64_t)(uintptr_t)&reactor->wake_value;
+    sqe->len = sizeof(reactor->wake_value);
+    sqe->user_data = URING_WAKE_TAG;
+    uringQueueSqe(&reactor->ring);
+    reactor->reading_wake = true;
+}
+
+static void free_stream(Reactor* reactor, Stream* stream) {
+    if (stream->prev) {
+        stream->prev->next = stream->next;
+    } else {
+        reactor->streams = stream->next;
+    }
+    if (stream->next) stream->next->prev = stream->prev;
+
+    release_queue(&stream->output);
+    release_queue(&stream->sent);
+    release_queue(&stream->input);
+    free(stream);
+}
+
+// Hands a completion handler's stream over to the loop, which cancels what
+// the ring holds for it and frees it once that is back. Called with the mutex held.
+static void detach_stream(Reactor* reactor, Handler* handler) {
+    Stream* stream = handler->ctx;
+    stream->removed = true;
+    release_queue(&stream->output);
+    queue_stream(reactor, stream);
+    handler->ctx = NULL;
+}
+
+// Called with the mutex held
+static void pause_stream(Reactor* reactor, Stream* stream, bool paused) {
+    if (stream->paused == paused) return;
+    stream->paused = paused;
+
+    // The loop hands over the input kept meanwhile and receives again
+    if (!paused) queue_stream(reactor, stream);
+}
+
+// Queues bytes for the ring, which sends them before the loop's next wait.
+// Called with the mutex held.
+static ssize_t stream_send(Reactor* reactor, Stream* stream, const void* buf, size_t len) {
+    if (stream->error) {
+        errno = stream->error;
+        return -1;
+    }
+    if (queued_bytes(&stream->sent) + queued_bytes(&stream->output) + len > MAX_OUTPUT ||
+        queue_output(&stream->output, buf, len) != 0) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    queue_stream(reactor, stream);
+    return (ssize_t)len;
+}
+
+// Brings the requests the ring holds for a stream in line with its state,
+// called on the loop thread with the mutex held. Returns false when the
+// ring had no room left.
+static bool submit_stream(Reactor* reactor, Stream* stream) {
+    if (stream->removed) {
+        if (stream->receiving && !stream->cancelling) {
+            if (!cancel_request(reactor, stream, REQUEST_RECV)) return false;
+            stream->cancelling = true;
+        }
+        // Nobody reads a removed fd's replies, a send the peer doesn't take would wait forever
+        if (stream->sending && !stream->send_cancelled) {
+            if (!cancel_request(reactor, stream, REQUEST_SEND)) return false;
+            stream->send_cancelled = true;
+        }
+        if (stream->requests == 0) free_stream(reactor, stream);
+        return true;
+    }
+
+    bool full = stream->paused && queued_bytes(&stream->input) >= MAX_PAUSED_INPUT;
+    if (stream->receiving && full && !stream->cancelling) {
+        if (!cancel_request(reactor, stream, REQUEST_RECV)) return false;
+        stream->cancelling = true;
+    }
+    if (!stream->receiving && !stream->ended && !full) {
+        if (!arm_receive(reactor, stream)) return false;
+    }
+    if (!stream->sending && !stream->error &&
+        queued_bytes(&stream->sent) + queued_bytes(&stream->output) > 0) {
+        if (!arm_send(reactor, stream)) return false;
+    }
+    return true;
+}
+
+// Hands data to a completion handler after the input it left earlier, or
+// only that input when data is NULL. Once it took everything it hears about
+// an end the recv reported. Runs on the loop thread without the mutex.
+static void deliver(Reactor* reactor, Stream* stream, const char* data, size_t len) {
+    OutputQueue* input = &stream->input;
+    bool kept = queued_bytes(input) > 0;
+    bool lost = false;
+
+    if (kept) {
+        if (len > 0 && queue_output(input, data, len) != 0) lost = true;
+        data = input->data + input->head;
+        len = queued_bytes(input);
+    }
+    if (len > 0) {
+        uint64_t start = monotonic_ns();
+        size_t taken = stream->func.recv(stream->fd, data, len, stream->ctx);
+        record_callback(reactor, (uint64_t)(uintptr_t)stream->func.recv, start);
+
+        if (taken > len) taken = len;
+        if (kept) {
+            consume_queue(input, taken);
+        } else if (taken < len && queue_output(input, data + taken, len - taken) != 0) {
+            lost = true;
         }
     }
+
+    pthread_mutex_lock(&reactor->mutex);
+    // Input that couldn't be kept ends the connection like a failed recv
+    if (lost) stream->ended = true;
+    bool tell = stream->ended && !stream->ended_told && !stream->removed && !stream->paused &&
+                queued_bytes(input) == 0;
+    if (tell) stream->ended_told = true;
+    // Paused with its input full, the loop cancels the recv
+    if (stream->paused && queued_bytes(input) >= MAX_PAUSED_INPUT) queue_stream(reactor, stream);
+    pthread_mutex_unlock(&reactor->mutex);
+
+    if (tell) {
+        uint64_t start = monotonic_ns();
+        stream->func.recv(stream->fd, NULL, 0, stream->ctx);
+        record_callback(reactor, (uint64_t)(uintptr_t)stream->func.recv, start);
+    }
+}
+
+// A completion of the multishot recv: data, the end of the connection, or
+// the end of the recv itself (cancelled or out of buffers), armed again later
+static void received(Reactor* reactor, Stream* stream, const UringCompletion* cqe) {
+    bool buffered = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+    const char* data = buffered ? uringBuffer(&reactor->buffers, cqe) : NULL;
+    size_t len = cqe->res > 0 ? (size_t)cqe->res : 0;
+
+    pthread_mutex_lock(&reactor->mutex);
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        stream->receiving = false;
+        stream->cancelling = false;
+        stream->requests--;
+        queue_stream(reactor, stream);
+    }
+    if (cqe->res == 0 || (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)) {
+        stream->ended = true;
+    }
+
+    bool hand_over = !stream->removed && !stream->paused && (len > 0 || stream->ended);
+    if (!stream->removed && !hand_over && len > 0) {
+        // Kept until the handler is resumed
+        if (queue_output(&stream->input, data, len) != 0) stream->ended = true;
+        if (queued_bytes(&stream->input) >= MAX_PAUSED_INPUT) queue_stream(reactor, stream);
+    }
+    pthread_mutex_unlock(&reactor->mutex);
+
+    if (hand_over) deliver(reactor, stream, data, len);
+    if (buffered) uringRecycleBuffer(&reactor->buffers, cqe);
+}
+
+static void accepted(Reactor* reactor, Stream* stream, const UringCompletion* cqe) {
+    pthread_mutex_lock(&reactor->mutex);
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        stream->receiving = false;
+        stream->cancelling = false;
+        stream->requests--;
+        queue_stream(reactor, stream);
+    }
+    bool removed = stream->removed;
+    pthread_mutex_unlock(&reactor->mutex);
+
+    if (removed) {
+        if (cqe->res >= 0) close(cqe->res);
+        return;
+    }
+    if (cqe->res == -ECANCELED) return;
+
+    int client_fd = cqe->res;
+    if (client_fd < 0) {
+        errno = -client_fd;
+        client_fd = -1;
+    }
+    uint64_t start = monotonic_ns();
+    stream->func.accept(stream->fd, client_fd, stream->ctx);
+    record_callback(reactor, (uint64_t)(uintptr_t)stream->func.accept, start);
+}
+
+static void sent(Reactor* reactor, Stream* stream, const UringCompletion* cqe) {
+    pthread_mutex_lock(&reactor->mutex);
+    stream->sending = false;
+    stream->requests--;
+    if (cqe->res >= 0) {
+        consume_queue(&stream->sent, (size_t)cqe->res);
+    } else {
+        // A peer that stopped reading for good loses what was queued,
+        // the recv reports the error to the handler
+        if (cqe->res != -ECANCELED) stream->error = -cqe->res;
+        release_queue(&stream->sent);
+        release_queue(&stream->output);
+    }
+    // The rest goes out, or the stream is freed, before the next wait
+    queue_stream(reactor, stream);
+    pthread_mutex_unlock(&reactor->mutex);
+}
+
+static void complete(Reactor* reactor, const UringCompletion* cqe) {
+    Stream* stream = (Stream*)(uintptr_t)(cqe->user_data & ~(uint64_t)REQUEST_MASK);
+    if (!stream) {
+        if (cqe->user_data == URING_EPOLL_TAG) {
+            struct epoll_event events[MAX_EVENTS];
+            reactor->polling = false;
+            int count = epoll_wait(reactor->epoll_fd, events, MAX_EVENTS, 0);
+            dispatch_epoll(reactor, events, count);
+        } else if (cqe->user_data == URING_WAKE_TAG) {
+            // Drained like drain_wake does
+            reactor->reading_wake = false;
+            __atomic_store_n(&reactor->wake_pending, 0, __ATOMIC_RELEASE);
+        }
+        return;
+    }
+
+    if ((cqe->user_data & REQUEST_MASK) == REQUEST_SEND) {
+        sent(reactor, stream, cqe);
+    } else if (stream->accepting) {
+        accepted(reactor, stream, cqe);
+    } else {
+        received(reactor, stream, cqe);
+    }
+}
+
+// Goes through the streams that changed since the last wait: resumed
+// handlers get the input kept for them, then the recvs, sends and
+// cancellations they need are queued. They reach the kernel with the wait,
+// in one io_uring_enter. Returns whether some are left for lack of room.
+static bool flush_streams(Reactor* reactor) {
+    bool left = false;
+    Stream* stream;
+
+    pthread_mutex_lock(&reactor->mutex);
+    while ((stream = reactor->flush_head) != NULL) {
+        reactor->flush_head = stream->next_flush;
+        if (!reactor->flush_head) reactor->flush_tail = NULL;
+        stream->queued = false;
+
+        if (!stream->removed && !stream->paused && !stream->accepting &&
+            (queued_bytes(&stream->input) > 0 || (stream->ended && !stream->ended_told))) {
+            pthread_mutex_unlock(&reactor->mutex);
+            deliver(reactor, stream, NULL, 0);
+            pthread_mutex_lock(&reactor->mutex);
+            // Queued again by its handler, its turn comes later in this pass
+            if (stream->queued) continue;
+        }
+
+        if (!submit_stream(reactor, stream)) {
+            queue_stream(reactor, stream);
+            left = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&reactor->mutex);
+    return left;
+}
+
+// Sets up the ring and its receive buffers, returns -1 when the kernel
+// can't run completion handlers
+static int uring_start(Reactor* reactor) {
+    if (uringInit(&reactor->ring, URING_ENTRIES, URING_CQ_ENTRIES) != 0) return -1;
+
+    // Multishot recv came in 6.0 along with IORING_OP_SEND_ZC, which the
+    // probe can tell about; provided buffer rings need 5.19
+    if (!uringSupports(&reactor->ring, IORING_OP_SEND_ZC) ||
+        uringRegisterBuffers(&reactor->ring, &reactor->buffers, RECV_BUFFER_GROUP,
+                             RECV_BUFFERS, RECV_BUFFER_SIZE) != 0) {
+        uringClose(&reactor->ring);
+        return -1;
+    }
+    // The ring reads the wakeup fd itself. A blocking read waits in the
+    // kernel, a non-blocking one would fail at once with EAGAIN.
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, reactor->wake_read, NULL);
+    fcntl(reactor->wake_read, F_SETFL, fcntl(reactor->wake_read, F_GETFL) & ~O_NONBLOCK);
+
+    reactor->polling = false;
+    reactor->reading_wake = false;
+    reactor->flush_head = reactor->flush_tail = NULL;
+    reactor->streams = NULL;
+    return 0;
+}
+
+// Called once the loop stopped. The kernel lets go of the buffers and
+// streams before they are freed.
+static void uring_stop(Reactor* reactor) {
+    uringCancelAll(&reactor->ring);
+    uringUnregisterBuffers(&reactor->ring, &reactor->buffers);
+    uringClose(&reactor->ring);
+    while (reactor->streams) {
+        free_stream(reactor, reactor->streams);
+    }
+}
+
+static void uringLoop(Reactor* reactor) {
+    UringCompletion cqes[MAX_EVENTS];
+
+    while (__atomic_load_n(&reactor->running, __ATOMIC_ACQUIRE)) {
+        bool left = flush_streams(reactor);
+        if (!reactor->polling) arm_epoll(reactor);
+        if (!reactor->reading_wake) arm_wake(reactor);
+
+        // One syscall submits every recv, send and poll queued since the last one
+        int timeout = left ? 0 : next_timeout(reactor);
+        uint64_t wait_start = monotonic_ns();
+        int result = uringSubmitAndWait(&reactor->ring, timeout);
+        uint64_t waited = monotonic_ns() - wait_start;
+        update_time(reactor);
+
+        if (result < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) perror("io_uring_enter");
+
+        unsigned ready = uringReapCqes(&reactor->ring, cqes, MAX_EVENTS);
+        record_wait(reactor, waited, ready);
+        for (unsigned i = 0; i < ready; i++) {
+            complete(reactor, &cqes[i]);
+        }
+
+        run_posted(reactor);
+        run_timers(reactor);
+    }
+}
+#endif
+
+
+static void* reactorLoop(void* arg) {
+    Reactor* reactor = (Reactor*)arg;
+    loopReactor = reactor;
+
+#ifdef HAVE_IO_URING
+    if (reactor->backend == REACTOR_BACKEND_IO_URING) {
+        uringLoop(reactor);
+        return NULL;
+    }
+#endif
+#ifdef HAVE_EPOLL
+    if (reactor->backend == REACTOR_BACKEND_EPOLL) {
+        epollLoop(reactor);
+        return NULL;
+    }
+#endif
+    selectLoop(reactor);
     return NULL;
 }
 
+static bool parse_backend(const char* name, ReactorBackend* backend) {
+    for (int i = 0; i <= REACTOR_BACKEND_IO_URING; i++) {
+        if (strcmp(name, backend_names[i]) == 0) {
+            *backend = (ReactorBackend)i;
+            return true;
+        }
+    }
+    return false;
+}
+
 Reactor* createReactor() {
+    ReactorBackend backend = DEFAULT_BACKEND;
+
+    const char* name = getenv(REACTOR_BACKEND_ENV);
+    if (name && !parse_backend(name, &backend)) {
+        fprintf(stderr, "Unknown %s '%s', using %s\n", REACTOR_BACKEND_ENV, name,
+                backend_names[DEFAULT_BACKEND]);
+    }
+
+    return createReactorWithBackend(backend);
+}
+
+Reactor* createReactorWithBackend(ReactorBackend backend) {
     Reactor* reactor = (Reactor*)malloc(sizeof(Reactor));
     if (!reactor) return NULL;
-    
-    FD_ZERO(&reactor->fds);
-    memset(reactor->handlers, 0, sizeof(reactor->handlers));
+
+    reactor->handlers = calloc(INITIAL_FDS, sizeof(Handler));
+    if (!reactor->handlers) {
+        free(reactor);
+        return NULL;
+    }
+    reactor->capacity = INITIAL_FDS;
+    reactor->now = monotonic_ms();
+    if (timerWheelInit(&reactor->timers, reactor->now) != 0) {
+        free(reactor->handlers);
+        free(reactor);
+        return NULL;
+    }
+    if (wake_init(reactor) != 0) {
+        timerWheelDestroy(&reactor->timers);
+        free(reactor->handlers);
+        free(reactor);
+        return NULL;
+    }
+    reactor->wake_pending = 0;
+    reactor->posted_head = reactor->posted_tail = NULL;
+    memset(&reactor->stats, 0, sizeof(reactor->stats));
+    pthread_mutex_init(&reactor->mutex, NULL);
+
+    FD_ZERO(&reactor->read_fds);
+    FD_ZERO(&reactor->write_fds);
     reactor->max_fd = -1;
+    reactor->epoll_fd = -1;
+    reactor->backend = REACTOR_BACKEND_SELECT;
+    reactor->watched = 0;
+
+#ifdef HAVE_EPOLL
+    if (backend != REACTOR_BACKEND_SELECT) {
+        reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (reactor->epoll_fd != -1) {
+            reactor->backend = REACTOR_BACKEND_EPOLL;
+
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.u64 = WAKE_TAG;
+            if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->wake_read, &event) != 0) {
+                perror("epoll_ctl wakeup");
+            }
+        } else {
+            perror("epoll_create1, falling back to select");
+        }
+    }
+#else
+    (void)backend;
+#endif
+
+#ifdef HAVE_IO_URING
+    // Kernels without io_uring, or too old for multishot recv, keep epoll.
+    // The ring waits on the epoll set as well, for the fds added with addFd*.
+    if (backend == REACTOR_BACKEND_IO_URING && reactor->epoll_fd != -1 && uring_start(reactor) == 0) {
+        reactor->backend = REACTOR_BACKEND_IO_URING;
+    }
+#endif
+
     reactor->running = 1;
-    
+
     if (pthread_create(&reactor->thread, NULL, reactorLoop, reactor) != 0) {
+#ifdef HAVE_IO_URING
+        if (reactor->backend == REACTOR_BACKEND_IO_URING) uring_stop(reactor);
+#endif
+        if (reactor->epoll_fd != -1) close(reactor->epoll_fd);
+        wake_close(reactor);
+        pthread_mutex_destroy(&reactor->mutex);
+        timerWheelDestroy(&reactor->timers);
+        free(reactor->handlers);
         free(reactor);
         return NULL;
     }
-    
+
     currentReactor = reactor;
     return reactor;
 }
 
-int addFd(Reactor* reactor, int fd, reactorFunc func) {
-    if (fd < 0 || fd >= MAX_FDS || !reactor || !func) return -1;
-    
-    FD_SET(fd, &reactor->fds);
-    reactor->handlers[fd] = func;
-    
-    if (fd > reactor->max_fd) {
+#ifdef HAVE_EPOLL
+static int epoll_register(Reactor* reactor, int fd, int interest, bool registered) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = ((interest & REACTOR_EVENT_READ) ? EPOLLIN : 0) |
+                   ((interest & REACTOR_EVENT_WRITE) ? EPOLLOUT : 0);
+    event.data.u64 = event_tag(fd, reactor->handlers[fd].generation);
+
+    // The table can be out of date when a handler closed fd without removeFd
+    int op = registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(reactor->epoll_fd, op, fd, &event) == 0) return 0;
+    if (errno != ENOENT && errno != EEXIST) return -1;
+
+    op = (op == EPOLL_CTL_MOD) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    return epoll_ctl(reactor->epoll_fd, op, fd, &event);
+}
+#endif
+
+// Moves the backend's watch on fd from old_interest to interest, called with the mutex held
+static int watch_fd(Reactor* reactor, int fd, int old_interest, int interest) {
+    Handler* handler = &reactor->handlers[fd];
+    handler->interest = interest;
+
+#ifdef HAVE_EPOLL
+    if (reactor->epoll_fd != -1) {
+        // Errors and hangups are reported even with no events asked for,
+        // so an fd nobody wants to hear from leaves the set
+        if (interest == 0) {
+            // Fails harmlessly if the fd was already closed
+            epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            return 0;
+        }
+        if (epoll_register(reactor, fd, interest, old_interest != 0) != 0) {
+            perror("epoll_ctl");
+            return -1;
+        }
+        return 0;
+    }
+#endif
+    (void)old_interest;
+
+    if (interest & REACTOR_EVENT_READ) {
+        FD_SET(fd, &reactor->read_fds);
+    } else {
+        FD_CLR(fd, &reactor->read_fds);
+    }
+    if (interest & REACTOR_EVENT_WRITE) {
+        FD_SET(fd, &reactor->write_fds);
+    } else {
+        FD_CLR(fd, &reactor->write_fds);
+    }
+
+    if (interest && fd > reactor->max_fd) {
         reactor->max_fd = fd;
+    } else if (!interest && fd == reactor->max_fd) {
+        // Update max_fd if needed
+        while (reactor->max_fd >= 0 && !FD_ISSET(reactor->max_fd, &reactor->read_fds) &&
+               !FD_ISSET(reactor->max_fd, &reactor->write_fds)) {
+            reactor->max_fd--;
+        }
     }
-    
+
+    // select works on a copy of the sets, epoll picks up changes while the
+    // loop waits
+    wake_reactor(reactor);
+    return 0;
+}
+
+// Brings the backend in line with the interest fd needs now, called with the mutex held
+static void update_interest(Reactor* reactor, int fd) {
+    Handler* handler = &reactor->handlers[fd];
+    int interest = wanted_interest(handler);
+    if (interest != handler->interest) {
+        watch_fd(reactor, fd, handler->interest, interest);
+    }
+}
+
+// request holds the callback, its kind and ctx
+static int register_fd(Reactor* reactor, int fd, int events, const Handler* request) {
+    if (fd < 0 || !reactor || request->kind == HANDLER_NONE || !request->func.fd) return -1;
+    if (reactor->backend == REACTOR_BACKEND_SELECT && fd >= FD_SETSIZE) return -1;
+
+    pthread_mutex_lock(&reactor->mutex);
+
+    if (ensure_capacity(reactor, fd) != 0) {
+        pthread_mutex_unlock(&reactor->mutex);
+        return -1;
+    }
+
+    Handler* handler = &reactor->handlers[fd];
+    bool registered = has_handler(handler);
+#ifdef HAVE_IO_URING
+    if (registered && handler->kind == HANDLER_STREAM) detach_stream(reactor, handler);
+#endif
+
+    // Output still queued was meant for whatever fd was registered before
+    free_output(handler);
+    handler->func = request->func;
+    handler->ctx = request->ctx;
+    handler->kind = request->kind;
+    handler->events = events;
+
+    if (watch_fd(reactor, fd, registered ? handler->interest : 0, events) != 0) {
+        handler->kind = HANDLER_NONE;
+        handler->ctx = NULL;
+        handler->events = handler->interest = 0;
+        if (registered) __atomic_store_n(&reactor->watched, reactor->watched - 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&reactor->mutex);
+        return -1;
+    }
+
+    if (!registered) {
+        __atomic_store_n(&reactor->watched, reactor->watched + 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&reactor->mutex);
+    return 0;
+}
+
+int addFd(Reactor* reactor, int fd, reactorFunc func) {
+    Handler request = { .func.fd = func, .kind = HANDLER_FD };
+    return register_fd(reactor, fd, REACTOR_EVENT_READ, &request);
+}
+
+int addFdEvents(Reactor* reactor, int fd, int events, reactorEventFunc func) {
+    Handler request = { .func.events = func, .kind = HANDLER_EVENTS };
+    return register_fd(reactor, fd, events, &request);
+}
+
+int addFdContext(Reactor* reactor, int fd, int events, reactorContextFunc func, void* ctx) {
+    Handler request = { .func.context = func, .ctx = ctx, .kind = HANDLER_CONTEXT };
+    return register_fd(reactor, fd, events, &request);
+}
+
+#ifdef HAVE_IO_URING
+// request holds the stream's callback, ctx and kind. The loop arms its
+// recv or accept before its next wait.
+static int register_stream(Reactor* reactor, int fd, const Stream* request) {
+    if (fd < 0 || !reactor || reactor->backend != REACTOR_BACKEND_IO_URING) return -1;
+
+    Stream* stream = (Stream*)malloc(sizeof(Stream));
+    if (!stream) return -1;
+    *stream = *request;
+    stream->fd = fd;
+
+    pthread_mutex_lock(&reactor->mutex);
+
+    if (ensure_capacity(reactor, fd) != 0) {
+        pthread_mutex_unlock(&reactor->mutex);
+        free(stream);
+        return -1;
+    }
+
+    Handler* handler = &reactor->handlers[fd];
+    bool registered = has_handler(handler);
+    if (registered && handler->kind == HANDLER_STREAM) {
+        detach_stream(reactor, handler);
+    } else if (registered) {
+        watch_fd(reactor, fd, handler->interest, 0);
+    }
+    free_output(handler);
+    handler->kind = HANDLER_STREAM;
+    handler->ctx = stream;
+    handler->events = REACTOR_EVENT_READ;
+
+    stream->prev = NULL;
+    stream->next = reactor->streams;
+    if (reactor->streams) reactor->streams->prev = stream;
+    reactor->streams = stream;
+    queue_stream(reactor, stream);
+
+    if (!registered) {
+        __atomic_store_n(&reactor->watched, reactor->watched + 1, __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&reactor->mutex);
+    return 0;
+}
+#endif
+
+int registerCompletionHandler(Reactor* reactor, int fd, reactorRecvFunc func, void* ctx) {
+#ifdef HAVE_IO_URING
+    if (!func) return -1;
+    Stream request = { .func.recv = func, .ctx = ctx };
+    return register_stream(reactor, fd, &request);
+#else
+    (void)reactor, (void)fd, (void)func, (void)ctx;
+    return -1;
+#endif
+}
+
+int addAcceptHandler(Reactor* reactor, int listen_fd, reactorAcceptFunc func, void* ctx) {
+#ifdef HAVE_IO_URING
+    if (!func) return -1;
+    Stream request = { .accepting = true, .func.accept = func, .ctx = ctx };
+    return register_stream(reactor, listen_fd, &request);
+#else
+    (void)reactor, (void)listen_fd, (void)func, (void)ctx;
+    return -1;
+#endif
+}
+
+void* getFdContext(Reactor* reactor, int fd) {
+    if (fd < 0 || !reactor) return NULL;
+
+    pthread_mutex_lock(&reactor->mutex);
+    void* ctx = fd < reactor->capacity ? reactor->handlers[fd].ctx : NULL;
+#ifdef HAVE_IO_URING
+    if (ctx && reactor->handlers[fd].kind == HANDLER_STREAM) ctx = ((Stream*)ctx)->ctx;
+#endif
+    pthread_mutex_unlock(&reactor->mutex);
+    return ctx;
+}
+
+int setFdEvents(Reactor* reactor, int fd, int events) {
+    if (fd < 0 || !reactor) return -1;
+
+    pthread_mutex_lock(&reactor->mutex);
+    if (fd >= reactor->capacity || !has_handler(&reactor->handlers[fd])) {
+        pthread_mutex_unlock(&reactor->mutex);
+        return -1;
+    }
+    reactor->handlers[fd].events = events;
+#ifdef HAVE_IO_URING
+    if (reactor->handlers[fd].kind == HANDLER_STREAM) {
+        pause_stream(reactor, reactor->handlers[fd].ctx, !(events & REACTOR_EVENT_READ));
+        pthread_mutex_unlock(&reactor->mutex);
+        return 0;
+    }
+#endif
+    update_interest(reactor, fd);
+    pthread_mutex_unlock(&reactor->mutex);
     return 0;
 }
 
 int removeFd(Reactor* reactor, int fd) {
-    if (fd < 0 || fd >= MAX_FDS || !reactor) return -1;
-    
-    FD_CLR(fd, &reactor->fds);
-    reactor->handlers[fd] = NULL;
-    
-    // Update max_fd if needed
-    if (fd == reactor->max_fd) {
-        while (reactor->max_fd >= 0 && !FD_ISSET(reactor->max_fd, &reactor->fds)) {
-            reactor->max_fd--;
-        }
+    if (fd < 0 || !reactor) return -1;
+
+    pthread_mutex_lock(&reactor->mutex);
+
+    if (fd >= reactor->capacity) {
+        pthread_mutex_unlock(&reactor->mutex);
+        return -1;
     }
-    
+
+    Handler* handler = &reactor->handlers[fd];
+    if (has_handler(handler)) {
+#ifdef HAVE_IO_URING
+        if (handler->kind == HANDLER_STREAM) detach_stream(reactor, handler);
+#endif
+        if (handler->kind != HANDLER_STREAM) watch_fd(reactor, fd, handler->interest, 0);
+        __atomic_store_n(&reactor->watched, reactor->watched - 1, __ATOMIC_RELAXED);
+    }
+
+    free_output(handler);
+    handler->kind = HANDLER_NONE;
+    handler->ctx = NULL;
+    handler->events = 0;
+    handler->generation = (handler->generation + 1) & GENERATION_MASK;
+
+    pthread_mutex_unlock(&reactor->mutex);
     return 0;
 }
 
+ssize_t reactorSend(Reactor* reactor, int fd, const void* buf, size_t len) {
+    if (fd < 0 || !reactor) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&reactor->mutex);
+
+    if (fd >= reactor->capacity || !has_handler(&reactor->handlers[fd])) {
+        pthread_mutex_unlock(&reactor->mutex);
+        errno = EBADF;
+        return -1;
+    }
+
+    Handler* handler = &reactor->handlers[fd];
+#ifdef HAVE_IO_URING
+    if (handler->kind == HANDLER_STREAM) {
+        ssize_t queued = stream_send(reactor, handler->ctx, buf, len);
+        pthread_mutex_unlock(&reactor->mutex);
+        return queued;
+    }
+#endif
+    const char* data = buf;
+    size_t sent = 0;
+
+    // Bytes already queued go first, so only an empty queue allows writing now
+    if (!handler->output || handler->output->tail == handler->output->head) {
+        while (sent < len) {
+            ssize_t n = send(fd, data + sent, len - sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                pthread_mutex_unlock(&reactor->mutex);
+                return -1;
+            }
+            sent += n;
+        }
+    }
+
+    if (sent < len) {
+        if (!handler->output) handler->output = calloc(1, sizeof(OutputQueue));
+        if (!handler->output || queue_output(handler->output, data + sent, len - sent) != 0) {
+            pthread_mutex_unlock(&reactor->mutex);
+            errno = ENOBUFS;
+            return -1;
+        }
+        update_interest(reactor, fd);
+    }
+
+    pthread_mutex_unlock(&reactor->mutex);
+    return (ssize_t)len;
+}
+
 Reactor* getCurrentReactor() {
-    return currentReactor;
+    return loopReactor ? loopReactor : currentReactor;
+}
+
+uint64_t getReactorTime(Reactor* reactor) {
+    return __atomic_load_n(&reactor->now, __ATOMIC_RELAXED);
+}
+
+TimerId addTimer(Reactor* reactor, unsigned delay_ms, timerFunc func, void* arg) {
+    if (!reactor) return 0;
+
+    // Timers count from now, not from the last loop wakeup
+    pthread_mutex_lock(&reactor->mutex);
+    TimerId id = timerWheelAdd(&reactor->timers, monotonic_ms() + delay_ms, func, arg);
+    pthread_mutex_unlock(&reactor->mutex);
+
+    // The loop may be asleep with a later deadline
+    if (id) wake_reactor(reactor);
+    return id;
+}
+
+int postToReactor(Reactor* reactor, postedFunc func, void* arg) {
+    if (!reactor || !func) return -1;
+
+    Posted* posted = (Posted*)malloc(sizeof(Posted));
+    if (!posted) return -1;
+    posted->func = func;
+    posted->arg = arg;
+    posted->next = NULL;
+
+    pthread_mutex_lock(&reactor->mutex);
+    if (reactor->posted_tail) {
+        reactor->posted_tail->next = posted;
+    } else {
+        reactor->posted_head = posted;
+    }
+    reactor->posted_tail = posted;
+    pthread_mutex_unlock(&reactor->mutex);
+
+    wake_reactor(reactor);
+    return 0;
+}
+
+int cancelTimer(Reactor* reactor, TimerId id) {
+    if (!reactor) return -1;
+
+    pthread_mutex_lock(&reactor->mutex);
+    int result = timerWheelCancel(&reactor->timers, id);
+    pthread_mutex_unlock(&reactor->mutex);
+    return result;
+}
+
+void getReactorStats(Reactor* reactor, ReactorStats* stats) {
+    const uint64_t* from = (const uint64_t*)&reactor->stats;
+    uint64_t* to = (uint64_t*)stats;
+    for (size_t i = 0; i < sizeof(ReactorStats) / sizeof(uint64_t); i++) {
+        to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+    }
+}
+
+int getReactorLoad(Reactor* reactor) {
+    return __atomic_load_n(&reactor->watched, __ATOMIC_RELAXED);
+}
+
+ReactorBackend getReactorBackend(Reactor* reactor) {
+    return reactor->backend;
+}
+
+const char* reactorBackendName(ReactorBackend backend) {
+    if (backend < REACTOR_BACKEND_SELECT || backend > REACTOR_BACKEND_IO_URING) return "unknown";
+    return backend_names[backend];
 }
 
 void stopReactor(Reactor* reactor) {
     if (!reactor) return;
-    
-    reactor->running = 0;
+
+    __atomic_store_n(&reactor->running, 0, __ATOMIC_RELEASE);
+    wake_reactor(reactor);
     pthread_join(reactor->thread, NULL);
-    
-    for (int fd = 0; fd <= reactor->max_fd; fd++) {
-        if (FD_ISSET(fd, &reactor->fds)) {
-            FD_CLR(fd, &reactor->fds);
-        }
+
+#ifdef HAVE_IO_URING
+    if (reactor->backend == REACTOR_BACKEND_IO_URING) {
+        uring_stop(reactor);
+    }
+#endif
+    if (reactor->epoll_fd != -1) {
+        close(reactor->epoll_fd);
     }
 
-    currentReactor = NULL;
+    if (currentReactor == reactor) {
+        currentReactor = NULL;
+    }
+    for (int fd = 0; fd < reactor->capacity; fd++) {
+        free_output(&reactor->handlers[fd]);
+    }
+    // Callbacks posted after the loop stopped never run
+    while (reactor->posted_head) {
+        Posted* next = reactor->posted_head->next;
+        free(reactor->posted_head);
+        reactor->posted_head = next;
+    }
+    wake_close(reactor);
+    pthread_mutex_destroy(&reactor->mutex);
+    timerWheelDestroy(&reactor->timers);
+    free(reactor->handlers);
     free(reactor);
-    
-}
\ No newline at end of file
+}
+
+ReactorGroup* createReactorGroup(int count, ReactorBalance balance) {
+    if (count < 1) return NULL;
+
+    ReactorGroup* group = (ReactorGroup*)malloc(sizeof(ReactorGroup));
+    if (!group) return NULL;
+
+    group->reactors = calloc(count, sizeof(Reactor*));
+    if (!group->reactors) {
+        free(group);
+        return NULL;
+    }
+    group->count = count;
+    group->balance = balance;
+    group->next = 0;
+
+    for (int i = 0; i < count; i++) {
+        group->reactors[i] = createReactor();
+        if (!group->reactors[i]) {
+            group->count = i;
+            stopReactorGroup(group);
+            return NULL;
+        }
+    }
+    return group;
+}
+
+int getReactorGroupSize(ReactorGroup* group) {
+    return group->count;
+}
+
+Reactor* getGroupReactor(ReactorGroup* group, int index) {
+    if (index < 0 || index >= group->count) return NULL;
+    return group->reactors[index];
+}
+
+Reactor* nextReactor(ReactorGroup* group) {
+    if (group->balance == REACTOR_BALANCE_LEAST_LOADED) {
+        // Loads are read without locking, a slightly stale count only
+        // makes the pick less even
+        Reactor* best = group->reactors[0];
+        int best_load = getReactorLoad(best);
+        for (int i = 1; i < group->count; i++) {
+            int load = getReactorLoad(group->reactors[i]);
+            if (load < best_load) {
+                best = group->reactors[i];
+                best_load = load;
+            }
+        }
+        return best;
+    }
+
+    unsigned index = __atomic_fetch_add(&group->next, 1, __ATOMIC_RELAXED);
+    return group->reactors[index % group->count];
+}
+
+void stopReactorGroup(ReactorGroup* group) {
+    if (!group) return;
+
+    for (int i = 0; i < group->count; i++) {
+        stopReactor(group->reactors[i]);
+    }
+    free(group->reactors);
+    free(group);
+}
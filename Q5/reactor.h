@@ -1,22 +1,164 @@
 #ifndef REACTOR_H
 #define REACTOR_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "timer.h"
+
+// Events a handler can ask for, or be told are ready
+#define REACTOR_EVENT_READ  0x1
+#define REACTOR_EVENT_WRITE 0x2
+
 typedef void (*reactorFunc)(int fd);
+typedef void (*reactorEventFunc)(int fd, int events);
+typedef void (*reactorContextFunc)(int fd, int events, void* ctx);
+typedef void (*postedFunc)(void* arg);
+typedef size_t (*reactorRecvFunc)(int fd, const char* data, size_t len, void* ctx);
+typedef void (*reactorAcceptFunc)(int listen_fd, int client_fd, void* ctx);
 typedef struct Reactor Reactor;
+typedef struct ReactorGroup ReactorGroup;
+
+// Ways the reactor can wait for ready fds
+typedef enum {
+    REACTOR_BACKEND_SELECT,   // select(), fds below FD_SETSIZE only
+    REACTOR_BACKEND_EPOLL,    // epoll, cost per wakeup follows the number of ready fds
+    REACTOR_BACKEND_IO_URING  // epoll plus an io_uring that does the I/O of completion handlers
+} ReactorBackend;
+
+// Environment variable that overrides the backend picked at build time
+#define REACTOR_BACKEND_ENV "REACTOR_BACKEND"
+
+// Callback time histograms: bucket 0 counts calls under 1 us,
+// bucket i calls from 2^(i-1) up to 2^i us, the last one everything longer
+#define REACTOR_STATS_BUCKETS 24
+
+// Distinct callbacks timed separately, later ones only count in the totals
+#define REACTOR_STATS_CALLBACKS 16
+
+// Every field is a uint64_t so the loop can publish them without locks
+typedef struct {
+    uint64_t func;        // callback address, 0 for an unused slot
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t histogram[REACTOR_STATS_BUCKETS];
+} ReactorCallbackStats;
+
+typedef struct {
+    uint64_t iterations;         // waits on the backend
+    uint64_t wait_ns;            // time blocked in those waits
+    uint64_t max_wait_ns;
+    uint64_t ready;              // events the waits returned
+    uint64_t max_ready;          // most events from one wait
+    uint64_t busy_ns;            // time in fd handlers, timers and posted callbacks
+    uint64_t longest_stall_ns;   // longest single callback
+    uint64_t longest_stall_func;
+    uint64_t callback_count;     // slots of callbacks in use
+    ReactorCallbackStats callbacks[REACTOR_STATS_CALLBACKS];
+} ReactorStats;
+
+// How a reactor group picks the reactor for a new connection
+typedef enum {
+    REACTOR_BALANCE_ROUND_ROBIN,  // each reactor in turn
+    REACTOR_BALANCE_LEAST_LOADED  // the reactor watching the fewest fds
+} ReactorBalance;
 
 // Creates and starts new reactor
 Reactor* createReactor();
 
-// Adds fd to reactor with callback function
+// Creates and starts new reactor on the given backend
+Reactor* createReactorWithBackend(ReactorBackend backend);
+
+// Adds fd to reactor with callback function, called when fd is readable
 int addFd(Reactor* reactor, int fd, reactorFunc func);
 
-// Removes fd from reactor
+// Adds fd to reactor for a mask of REACTOR_EVENT_* flags, func gets the ones ready
+int addFdEvents(Reactor* reactor, int fd, int events, reactorEventFunc func);
+
+// Adds fd to reactor for a mask of REACTOR_EVENT_* flags, func gets the ones
+// ready along with ctx, so per-connection state needs no lookup by fd
+int addFdContext(Reactor* reactor, int fd, int events, reactorContextFunc func, void* ctx);
+
+// Returns the ctx fd was added with, NULL for other registrations
+void* getFdContext(Reactor* reactor, int fd);
+
+// Changes the events fd is watched for. For a completion handler, dropping
+// REACTOR_EVENT_READ pauses the calls to func until it is set again
+int setFdEvents(Reactor* reactor, int fd, int events);
+
+// Completion handlers, io_uring backend only: the ring does the socket I/O and
+// the callbacks get its results, so a command costs no recv or send syscall.
+// They return -1 on other backends, check getReactorBackend first.
+
+// Hands what arrives on fd to func as it comes in, through one multishot recv
+// into buffers the reactor provides. func returns how many bytes it took; the
+// rest is handed to it again, ahead of newer data, when more arrives or after
+// it was paused and resumed with setFdEvents. len is 0 (data NULL) once the
+// peer closed or the connection failed. reactorSend on fd queues the bytes
+// for the ring, every send of a loop iteration goes out in one io_uring_enter
+int registerCompletionHandler(Reactor* reactor, int fd, reactorRecvFunc func, void* ctx);
+
+// Accepts connections on listen_fd through one multishot accept, func gets
+// each new fd, or -1 with errno set when an accept failed
+int addAcceptHandler(Reactor* reactor, int listen_fd, reactorAcceptFunc func, void* ctx);
+
+// Removes fd from reactor, dropping output still queued for it. The fd can be
+// closed right after, requests the ring still holds for it are cancelled
 int removeFd(Reactor* reactor, int fd);
 
-//Return the current reactor
+// Sends on a registered socket without blocking. What the socket can't take
+// now is queued and written by the reactor once the socket is writable.
+// Returns len, or -1 if the connection failed or the queue is full (ENOBUFS)
+ssize_t reactorSend(Reactor* reactor, int fd, const void* buf, size_t len);
+
+// Returns the reactor whose loop runs on the calling thread,
+// or the last one created when called from any other thread
 Reactor* getCurrentReactor();
 
+// Runs func(arg) on the reactor thread once delay_ms have passed,
+// returns 0 if the timer couldn't be added
+TimerId addTimer(Reactor* reactor, unsigned delay_ms, timerFunc func, void* arg);
+
+// Runs func(arg) on the reactor thread as soon as it can, callable from any
+// thread. Lets workers hand results back to the loop that owns the fds.
+int postToReactor(Reactor* reactor, postedFunc func, void* arg);
+
+// Cancels a timer that hasn't run yet, returns -1 if it already ran
+int cancelTimer(Reactor* reactor, TimerId id);
+
+// Returns the monotonic time in ms the reactor's loop last woke up at
+uint64_t getReactorTime(Reactor* reactor);
+
+// Copies the reactor's counters, callable from any thread. Each reactor
+// thread keeps its own, so a copy taken elsewhere can lag a few events.
+void getReactorStats(Reactor* reactor, ReactorStats* stats);
+
+// Returns how many fds the reactor has handlers for
+int getReactorLoad(Reactor* reactor);
+
+// Returns the backend the reactor waits with
+ReactorBackend getReactorBackend(Reactor* reactor);
+
+// Returns the name REACTOR_BACKEND_ENV accepts for the backend
+const char* reactorBackendName(ReactorBackend backend);
+
 // Stops and destroys reactor
 void stopReactor(Reactor* reactor);
 
-#endif
\ No newline at end of file
+// Creates and starts count reactors, each with its own thread
+ReactorGroup* createReactorGroup(int count, ReactorBalance balance);
+
+// Returns the number of reactors in the group
+int getReactorGroupSize(ReactorGroup* group);
+
+// Returns reactor index of the group, NULL when out of range
+Reactor* getGroupReactor(ReactorGroup* group, int index);
+
+// Picks the reactor the next connection should be added to
+Reactor* nextReactor(ReactorGroup* group);
+
+// Stops and destroys every reactor in the group, then the group
+void stopReactorGroup(ReactorGroup* group);
+
+#endif
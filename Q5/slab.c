@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "slab.h"
+
+#define CACHE_LINE 64
+#define INITIAL_CHUNKS 8
+
+// A free object holds the link to the next one
+typedef struct FreeObject {
+    struct FreeObject* next;
+} FreeObject;
+
+struct Slab {
+    size_t object_size;   // rounded up to whole cache lines
+    int per_chunk;
+    char** chunks;
+    int chunk_count;
+    int chunk_capacity;
+    FreeObject* free_list;
+    int in_use;
+    pthread_mutex_t mutex;
+};
+
+Slab* createSlab(size_t object_size, int objects_per_chunk) {
+    if (object_size == 0 || objects_per_chunk < 1) return NULL;
+
+    Slab* slab = (Slab*)calloc(1, sizeof(Slab));
+    if (!slab) return NULL;
+
+    if (object_size < sizeof(FreeObject)) object_size = sizeof(FreeObject);
+    slab->object_size = (object_size + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    slab->per_chunk = objects_per_chunk;
+    pthread_mutex_init(&slab->mutex, NULL);
+    return slab;
+}
+
+// Takes a new chunk and threads its objects onto the free list, called with the mutex held
+static int add_chunk(Slab* slab) {
+    if (slab->chunk_count == slab->chunk_capacity) {
+        int capacity = slab->chunk_capacity ? slab->chunk_capacity * 2 : INITIAL_CHUNKS;
+        char** grown = realloc(slab->chunks, capacity * sizeof(char*));
+        if (!grown) return -1;
+        slab->chunks = grown;
+        slab->chunk_capacity = capacity;
+    }
+
+    char* chunk = aligned_alloc(CACHE_LINE, slab->object_size * slab->per_chunk);
+    if (!chunk) return -1;
+    slab->chunks[slab->chunk_count++] = chunk;
+
+    // Lowest address first, so consecutive allocations sit next to each other
+    for (int i = slab->per_chunk - 1; i >= 0; i--) {
+        FreeObject* object = (FreeObject*)(chunk + i * slab->object_size);
+        object->next = slab->free_list;
+        slab->free_list = object;
+    }
+    return 0;
+}
+
+void* slabAlloc(Slab* slab) {
+    if (!slab) return NULL;
+
+    pthread_mutex_lock(&slab->mutex);
+    if (!slab->free_list && add_chunk(slab) != 0) {
+        pthread_mutex_unlock(&slab->mutex);
+        return NULL;
+    }
+    FreeObject* object = slab->free_list;
+    slab->free_list = object->next;
+    slab->in_use++;
+    pthread_mutex_unlock(&slab->mutex);
+
+    memset(object, 0, slab->object_size);
+    return object;
+}
+
+void slabFree(Slab* slab, void* object) {
+    if (!slab || !object) return;
+
+    pthread_mutex_lock(&slab->mutex);
+    FreeObject* freed = (FreeObject*)object;
+    freed->next = slab->free_list;
+    slab->free_list = freed;
+    slab->in_use--;
+    pthread_mutex_unlock(&slab->mutex);
+}
+
+int getSlabCount(Slab* slab) {
+    pthread_mutex_lock(&slab->mutex);
+    int count = slab->in_use;
+    pthread_mutex_unlock(&slab->mutex);
+    return count;
+}
+
+void destroySlab(Slab* slab) {
+    if (!slab) return;
+
+    for (int i = 0; i < slab->chunk_count; i++) {
+        free(slab->chunks[i]);
+    }
+    free(slab->chunks);
+    pthread_mutex_destroy(&slab->mutex);
+    free(slab);
+}
@@ -0,0 +1,27 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Fixed size objects carved out of large chunks, for per-connection state.
+// Each object starts on its own cache line, freed objects are handed out
+// again before a new chunk is taken, and chunks only go back to the system
+// when the slab is destroyed. Safe to use from any thread.
+typedef struct Slab Slab;
+
+// Creates a slab of object_size objects, objects_per_chunk at a time
+Slab* createSlab(size_t object_size, int objects_per_chunk);
+
+// Returns a zeroed object, NULL if out of memory
+void* slabAlloc(Slab* slab);
+
+// Gives an object from slabAlloc back to the slab
+void slabFree(Slab* slab, void* object);
+
+// Returns how many objects are handed out
+int getSlabCount(Slab* slab);
+
+// Frees every chunk, objects still handed out become invalid
+void destroySlab(Slab* slab);
+
+#endif
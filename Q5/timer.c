@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timer.h"
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define INITIAL_TIMERS 64
+
+// Largest delay the top level holds, later timers wait in its last slot
+#define WHEEL_RANGE (1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+
+static TimerId make_id(int index, uint32_t generation) {
+    return ((uint64_t)generation << 32) | (uint32_t)index;
+}
+
+static void link_node(TimerWheel* wheel, int index, int level, int slot) {
+    TimerNode* node = &wheel->nodes[index];
+    int* head = &wheel->slots[level][slot];
+
+    node->level = level;
+    node->slot = slot;
+    node->prev = -1;
+    node->next = *head;
+    if (*head != -1) wheel->nodes[*head].prev = index;
+    *head = index;
+    wheel->level_counts[level]++;
+}
+
+static void unlink_node(TimerWheel* wheel, int index) {
+    TimerNode* node = &wheel->nodes[index];
+
+    if (node->prev != -1) {
+        wheel->nodes[node->prev].next = node->next;
+    } else {
+        wheel->slots[node->level][node->slot] = node->next;
+    }
+    if (node->next != -1) wheel->nodes[node->next].prev = node->prev;
+    wheel->level_counts[node->level]--;
+}
+
+// Puts a node on the lowest level whose range covers its delay
+static void place_node(TimerWheel* wheel, int index) {
+    uint64_t expires = wheel->nodes[index].expires;
+    if (expires < wheel->tick) expires = wheel->tick;
+
+    uint64_t delta = expires - wheel->tick;
+    if (delta >= WHEEL_RANGE) expires = wheel->tick + WHEEL_RANGE - 1;
+
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1)))) level++;
+
+    int slot = (int)((expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    link_node(wheel, index, level, slot);
+}
+
+static void free_node(TimerWheel* wheel, int index) {
+    TimerNode* node = &wheel->nodes[index];
+    node->generation++;
+    if (node->generation == 0) node->generation = 1;
+    node->level = -1;
+    node->next = wheel->free_list;
+    wheel->free_list = index;
+    wheel->count--;
+}
+
+static int grow_nodes(TimerWheel* wheel) {
+    int capacity = wheel->capacity ? wheel->capacity * 2 : INITIAL_TIMERS;
+
+    TimerNode* grown = realloc(wheel->nodes, capacity * sizeof(TimerNode));
+    if (!grown) return -1;
+    wheel->nodes = grown;
+
+    // New nodes go on the free list, lowest index first
+    for (int i = capacity - 1; i >= wheel->capacity; i--) {
+        memset(&grown[i], 0, sizeof(TimerNode));
+        grown[i].generation = 1;
+        grown[i].level = -1;
+        grown[i].next = wheel->free_list;
+        wheel->free_list = i;
+    }
+    wheel->capacity = capacity;
+    return 0;
+}
+
+int timerWheelInit(TimerWheel* wheel, uint64_t now) {
+    memset(wheel, 0, sizeof(*wheel));
+    memset(wheel->slots, -1, sizeof(wheel->slots));
+    wheel->free_list = -1;
+    wheel->tick = now;
+    return grow_nodes(wheel);
+}
+
+void timerWheelDestroy(TimerWheel* wheel) {
+    free(wheel->nodes);
+    wheel->nodes = NULL;
+    wheel->capacity = 0;
+}
+
+TimerId timerWheelAdd(TimerWheel* wheel, uint64_t expires, timerFunc func, void* arg) {
+    if (!func) return 0;
+    if (wheel->free_list == -1 && grow_nodes(wheel) != 0) return 0;
+
+    int index = wheel->free_list;
+    TimerNode* node = &wheel->nodes[index];
+    wheel->free_list = node->next;
+
+    node->func = func;
+    node->arg = arg;
+    node->expires = expires;
+    wheel->count++;
+    place_node(wheel, index);
+    return make_id(index, node->generation);
+}
+
+int timerWheelCancel(TimerWheel* wheel, TimerId id) {
+    int index = (int)(uint32_t)id;
+    uint32_t generation = (uint32_t)(id >> 32);
+    if (index < 0 || index >= wheel->capacity) return -1;
+
+    TimerNode* node = &wheel->nodes[index];
+    if (node->level == -1 || node->generation != generation) return -1;
+
+    unlink_node(wheel, index);
+    free_node(wheel, index);
+    return 0;
+}
+
+// Moves every timer in one slot of a higher level down to where it now belongs
+static void cascade_slot(TimerWheel* wheel, int level, int slot) {
+    int index = wheel->slots[level][slot];
+    wheel->slots[level][slot] = -1;
+
+    while (index != -1) {
+        int next = wheel->nodes[index].next;
+        wheel->level_counts[level]--;
+        place_node(wheel, index);
+        index = next;
+    }
+}
+
+// Steps to the next tick worth looking at, cascading at level boundaries
+static void advance(TimerWheel* wheel, uint64_t now) {
+    wheel->tick++;
+
+    if (wheel->count == 0) {
+        if (wheel->tick <= now) wheel->tick = now + 1;
+        return;
+    }
+
+    // With the lower levels empty nothing can happen before the next
+    // boundary of the first level that has timers
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && wheel->level_counts[level] == 0) level++;
+    if (level > 0 && (wheel->tick & WHEEL_MASK) != 0) {
+        uint64_t span = 1ULL << (WHEEL_BITS * level);
+        uint64_t next = (wheel->tick + span - 1) & ~(span - 1);
+        wheel->tick = next < now + 1 ? next : now + 1;
+    }
+
+    // Each time a level wraps, the next slot of the level above comes due
+    for (int upper = 1; upper < WHEEL_LEVELS; upper++) {
+        if ((wheel->tick & ((1ULL << (WHEEL_BITS * upper)) - 1)) != 0) break;
+        cascade_slot(wheel, upper, (int)((wheel->tick >> (WHEEL_BITS * upper)) & WHEEL_MASK));
+    }
+}
+
+int timerWheelExpire(TimerWheel* wheel, uint64_t now, timerFunc* func, void** arg) {
+    while (wheel->tick <= now) {
+        int index = wheel->slots[0][wheel->tick & WHEEL_MASK];
+        if (index != -1) {
+            TimerNode* node = &wheel->nodes[index];
+            *func = node->func;
+            *arg = node->arg;
+            unlink_node(wheel, index);
+            free_node(wheel, index);
+            return 1;
+        }
+        advance(wheel, now);
+    }
+    return 0;
+}
+
+long timerWheelTimeout(const TimerWheel* wheel, uint64_t now) {
+    if (wheel->count == 0) return -1;
+
+    uint64_t next = UINT64_MAX;
+    if (wheel->level_counts[0] > 0) {
+        for (uint64_t tick = wheel->tick; tick < wheel->tick + WHEEL_SLOTS; tick++) {
+            if (wheel->slots[0][tick & WHEEL_MASK] != -1) {
+                next = tick;
+                break;
+            }
+        }
+    }
+
+    // Timers on higher levels move down at the next level 0 wrap
+    if (wheel->count > wheel->level_counts[0]) {
+        uint64_t boundary = (wheel->tick | WHEEL_MASK) + 1;
+        if (boundary < next) next = boundary;
+    }
+
+    return next <= now ? 0 : (long)(next - now);
+}
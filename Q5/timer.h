@@ -0,0 +1,60 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+typedef void (*timerFunc)(void* arg);
+
+// Names a scheduled timer, 0 is never a valid id
+typedef uint64_t TimerId;
+
+// Each level has 64 slots, a slot on level n spans 64^n milliseconds,
+// so four levels reach about 4.6 hours before timers are parked at the top
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+
+typedef struct {
+    timerFunc func;
+    void* arg;
+    uint64_t expires;      // milliseconds, same clock as the wheel
+    uint32_t generation;   // bumped when the node is freed, stale ids fail to match
+    int level;             // -1 while the node is free
+    int slot;
+    int prev;
+    int next;
+} TimerNode;
+
+// Hierarchical timer wheel, not thread safe.
+// Nodes live in one growable array and link by index.
+typedef struct {
+    TimerNode* nodes;
+    int capacity;
+    int free_list;
+    int slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    int level_counts[WHEEL_LEVELS];
+    int count;
+    uint64_t tick;   // next millisecond to process
+} TimerWheel;
+
+// Sets up an empty wheel starting at now, returns -1 if out of memory
+int timerWheelInit(TimerWheel* wheel, uint64_t now);
+
+// Frees every node
+void timerWheelDestroy(TimerWheel* wheel);
+
+// Schedules func(arg) at expires, returns 0 if out of memory
+TimerId timerWheelAdd(TimerWheel* wheel, uint64_t expires, timerFunc func, void* arg);
+
+// Unschedules a timer, returns -1 if it already ran or was cancelled
+int timerWheelCancel(TimerWheel* wheel, TimerId id);
+
+// Takes one timer due at or before now off the wheel,
+// returns 0 once nothing is due
+int timerWheelExpire(TimerWheel* wheel, uint64_t now, timerFunc* func, void** arg);
+
+// Milliseconds after now the wheel next needs expiring, -1 if it is empty.
+// This may be a level boundary where timers move down rather than a deadline.
+long timerWheelTimeout(const TimerWheel* wheel, uint64_t now);
+
+#endif
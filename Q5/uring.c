@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uring.h"
+
+static int uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_register(int fd, unsigned opcode, void* arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                       void* arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+int uringInit(Uring* ring, unsigned entries, unsigned cq_entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+
+    // The kernel lowers cq_entries to its maximum instead of failing.
+    // COOP_TASKRUN (5.19) spares the loop thread an interrupt per completion,
+    // older kernels reject it so setup is retried without
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = cq_entries;
+
+    ring->fd = uring_setup(entries, &params);
+    if (ring->fd < 0 && errno == EINVAL) {
+        params.flags &= ~IORING_SETUP_COOP_TASKRUN;
+        ring->fd = uring_setup(entries, &params);
+    }
+    if (ring->fd < 0) return -1;
+
+    // The timed wait needs EXT_ARG (5.11), one mmap for both rings keeps setup simple
+    unsigned needed = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+    if ((params.features & needed) != needed) {
+        close(ring->fd);
+        return -1;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+    ring->cq_ring_size = ring->sq_ring_size;
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        close(ring->fd);
+        return -1;
+    }
+    ring->cq_ring = ring->sq_ring;
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+        close(ring->fd);
+        return -1;
+    }
+
+    char* sq = ring->sq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned*)(sq + params.sq_off.ring_entries);
+
+    char* cq = ring->cq_ring;
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cq_entries = *(unsigned*)(cq + params.cq_off.ring_entries);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+void uringClose(Uring* ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+}
+
+struct io_uring_sqe* uringNextSqe(Uring* ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail;
+    if (tail - head >= ring->sq_entries) return NULL;
+
+    unsigned index = tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+void uringQueueSqe(Uring* ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static unsigned pending_sqes(Uring* ring) {
+    return *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+}
+
+int uringSubmit(Uring* ring) {
+    unsigned pending = pending_sqes(ring);
+    if (pending == 0) return 0;
+    return uring_enter(ring->fd, pending, 0, 0, NULL, 0);
+}
+
+int uringSubmitAndWait(Uring* ring, int timeout_ms) {
+    struct __kernel_timespec ts = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (timeout_ms % 1000) * 1000000LL
+    };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_ms >= 0) arg.ts = (unsigned long long)(uintptr_t)&ts;
+
+    // Asking to submit more than is queued makes the kernel skip the wait
+    return uring_enter(ring->fd, pending_sqes(ring), 1,
+                       IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+unsigned uringReapCqes(Uring* ring, UringCompletion* out, unsigned max) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+
+    while (head != tail && count < max) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+        out[count].user_data = cqe->user_data;
+        out[count].res = cqe->res;
+        out[count].flags = cqe->flags;
+        count++;
+        head++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+void uringCancelAll(Uring* ring) {
+    struct io_uring_sync_cancel_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.flags = IORING_ASYNC_CANCEL_ANY;
+    reg.timeout.tv_sec = -1;
+    reg.timeout.tv_nsec = -1;
+    uring_register(ring->fd, IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+}
+
+bool uringSupports(Uring* ring, int opcode) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if (!probe) return false;
+
+    bool supported = false;
+    if (uring_register(ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0 && opcode <= probe->last_op) {
+        supported = (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+    free(probe);
+    return supported;
+}
+
+int uringRegisterBuffers(Uring* ring, UringBuffers* buffers, unsigned short group,
+                         unsigned count, unsigned size) {
+    memset(buffers, 0, sizeof(*buffers));
+    buffers->ring_size = count * sizeof(struct io_uring_buf);
+    buffers->ring = mmap(NULL, buffers->ring_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers->ring == MAP_FAILED) return -1;
+
+    buffers->data = malloc((size_t)count * size);
+    if (!buffers->data) {
+        munmap(buffers->ring, buffers->ring_size);
+        return -1;
+    }
+    buffers->count = count;
+    buffers->size = size;
+    buffers->group = group;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (unsigned long long)(uintptr_t)buffers->ring;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        free(buffers->data);
+        munmap(buffers->ring, buffers->ring_size);
+        return -1;
+    }
+
+    for (unsigned id = 0; id < count; id++) {
+        struct io_uring_buf* buf = &buffers->ring->bufs[id];
+        buf->addr = (unsigned long long)(uintptr_t)(buffers->data + (size_t)id * size);
+        buf->len = size;
+        buf->bid = (unsigned short)id;
+    }
+    buffers->tail = (unsigned short)count;
+    __atomic_store_n(&buffers->ring->tail, buffers->tail, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void uringUnregisterBuffers(Uring* ring, UringBuffers* buffers) {
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = buffers->group;
+    uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    free(buffers->data);
+    munmap(buffers->ring, buffers->ring_size);
+}
+
+char* uringBuffer(UringBuffers* buffers, const UringCompletion* completion) {
+    unsigned id = completion->flags >> IORING_CQE_BUFFER_SHIFT;
+    return buffers->data + (size_t)id * buffers->size;
+}
+
+void uringRecycleBuffer(UringBuffers* buffers, const UringCompletion* completion) {
+    unsigned id = completion->flags >> IORING_CQE_BUFFER_SHIFT;
+    struct io_uring_buf* buf = &buffers->ring->bufs[buffers->tail & (buffers->count - 1)];
+    buf->addr = (unsigned long long)(uintptr_t)(buffers->data + (size_t)id * buffers->size);
+    buf->len = buffers->size;
+    buf->bid = (unsigned short)id;
+    buffers->tail++;
+    __atomic_store_n(&buffers->ring->tail, buffers->tail, __ATOMIC_RELEASE);
+}
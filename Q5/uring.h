@@ -0,0 +1,98 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+// Minimal io_uring wrapper over the raw syscalls, so the reactor needs no liburing
+typedef struct {
+    int fd;
+
+    // Submission ring, shared with the kernel
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe* sqes;
+
+    // Completion ring, shared with the kernel
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    unsigned cq_entries;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} Uring;
+
+// Copy of the fields of a completion the reactor uses
+typedef struct {
+    __u64 user_data;
+    __s32 res;
+    __u32 flags;
+} UringCompletion;
+
+// Receive buffers registered as a provided buffer ring: a recv with
+// IOSQE_BUFFER_SELECT takes one when data arrives, so a multishot recv
+// holds no buffer of its own while its connection is quiet
+typedef struct {
+    struct io_uring_buf_ring* ring;   // shared with the kernel
+    size_t ring_size;
+    char* data;                       // count buffers of size bytes, back to back
+    unsigned count;
+    unsigned size;
+    unsigned short group;
+    unsigned short tail;
+} UringBuffers;
+
+// Sets up a ring with room for cq_entries completions (clamped to the kernel's limit),
+// returns -1 when the kernel lacks io_uring or the features used here
+int uringInit(Uring* ring, unsigned entries, unsigned cq_entries);
+
+// Unmaps and closes the ring
+void uringClose(Uring* ring);
+
+// Returns a zeroed submission entry, or NULL when the ring is full
+struct io_uring_sqe* uringNextSqe(Uring* ring);
+
+// Makes the entry returned by uringNextSqe visible to the kernel
+void uringQueueSqe(Uring* ring);
+
+// Submits queued entries without waiting, returns what io_uring_enter returned
+int uringSubmit(Uring* ring);
+
+// Submits queued entries and waits up to timeout_ms (-1 for no limit) for at
+// least one completion
+int uringSubmitAndWait(Uring* ring, int timeout_ms);
+
+// Copies up to max completions into out and releases them to the kernel
+unsigned uringReapCqes(Uring* ring, UringCompletion* out, unsigned max);
+
+// Cancels every request in flight and waits until the kernel dropped them,
+// so the memory they point at can be freed
+void uringCancelAll(Uring* ring);
+
+// Returns whether the kernel knows opcode
+bool uringSupports(Uring* ring, int opcode);
+
+// Registers count buffers of size bytes as buffer group group, count a power of two.
+// Returns -1 when the kernel has no provided buffer rings (before 5.19)
+int uringRegisterBuffers(Uring* ring, UringBuffers* buffers, unsigned short group,
+                         unsigned count, unsigned size);
+
+// Unregisters the buffers and frees them
+void uringUnregisterBuffers(Uring* ring, UringBuffers* buffers);
+
+// Returns the buffer a completion with IORING_CQE_F_BUFFER names
+char* uringBuffer(UringBuffers* buffers, const UringCompletion* completion);
+
+// Hands the buffer of a completion back to the kernel once its data is used
+void uringRecycleBuffer(UringBuffers* buffers, const UringCompletion* completion);
+
+#endif
@@ -1,38 +1,107 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <dlfcn.h>
 #include <unistd.h>
 #include <math.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "reactor.h"
+#include "graph.h"
+#include "command.h"
+#include "pool.h"
+#include "slab.h"
 
 #define PORT "9034"
-#define BACKLOG 10
+#define BACKLOG SOMAXCONN
+#define DEFAULT_IDLE_SECONDS 300
+#define HULL_QUEUE_DEPTH 1024
+#define INGEST_INITIAL_POINTS 4096
+#define CONNECTIONS_PER_CHUNK 256
 
-// Structure for 2D point
-typedef struct {
-    float x;
-    float y;
-} Point;
+// Reactors the connections are spread over, the listener sits on the first
+ReactorGroup* reactors;
+
+// Connections quiet for this long are closed, 0 keeps them forever
+unsigned idle_timeout_ms = DEFAULT_IDLE_SECONDS * 1000;
 
-// Global graph state
-Point* graph_points = NULL;
-int num_points = 0;
+// Hulls are computed here so a big graph doesn't freeze a reactor
+ThreadPool* workers;
+
+// A Newgraph still taking points. Each read adds whatever lines arrived,
+// the graph only changes once the last point is in.
+typedef struct {
+    Graph* graph;
+    Point* points;
+    int expected;   // 0 between commands
+    int received;
+    int capacity;
+    const char* failure;   // why the graph is rejected, NULL while it is fine;
+                           // the rest of its lines are only counted
+} Ingest;
+
+// Everything a connection needs, handed to its callbacks as the reactor ctx.
+// Only the reactor watching the fd touches it, add_client fills it in
+// before registering it there.
+typedef struct {
+    int fd;
+    Graph* graph;      // selected with Use, starts on the default graph
+    uint64_t active;   // reactor time of the last input
+    TimerId timer;     // checks active against the idle timeout
+    bool busy;         // waiting for a hull, later commands wait too
+    bool closed;       // closed while busy, hull_done frees it
+    Ingest ingest;
+    LineReader* reader;   // allocated on the first read, so idle connections
+                          // stay a couple of cache lines in the slab
+} Connection;
+
+// Connection contexts, allocated on the listener's reactor and freed on
+// whichever reactor the connection ended up on
+Slab* connections;
+
+// A CH handed to the workers, the reply goes back through the client's reactor
+typedef struct {
+    Reactor* reactor;
+    Graph* graph;
+    Connection* conn;
+    int n;
+    double area;
+} HullJob;
 
 // Function declarations
 void accept_handler(int listen_fd);
-void client_handler(int client_fd);
-void handle_newgraph(int n, int fd);
-void handle_newpoint(float x, float y);
-bool handle_removepoint(float x, float y);
-void handle_ch(int fd);
+void accept_done(int listen_fd, int client_fd, void* ctx);
+void add_client(int client_fd);
+void client_handler(int client_fd, int events, void* ctx);
+size_t client_received(int client_fd, const char* data, size_t len, void* ctx);
+bool ensure_reader(Connection* conn);
+void close_client(Connection* conn);
+void idle_check(void* arg);
+void handle_newgraph(Connection* conn, int n);
+void ingest_line(Connection* conn, const char* line, size_t len);
+void free_ingest(Connection* conn);
+int handle_newpoint(Graph* graph, Coord x, Coord y);
+bool handle_removepoint(Graph* graph, Coord x, Coord y);
+void handle_ch(Connection* conn);
+void reply_area(int fd, int n, double area);
+void hull_task(void* arg);
+void hull_done(void* arg);
+void process_lines(Connection* conn);
+void handle_use(Connection* conn, const char* name);
+void handle_stats(int fd);
+void handle_command(Command* cmd, Connection* conn);
+void send_reply(int fd, const char* msg, size_t len);
 void *get_in_addr(struct sockaddr *sa);
+void raise_fd_limit(void);
 
 void *get_in_addr(struct sockaddr *sa) {
     if (sa->sa_family == AF_INET) {
@@ -41,175 +110,407 @@ void *get_in_addr(struct sockaddr *sa) {
     return &(((struct sockaddr_in6*)sa)->sin6_addr);
 }
 
-int orientation(Point p, Point q, Point r) {
-    float val = (q.y - p.y) * (r.x - q.x) - (q.x - p.x) * (r.y - q.y);
-    if (fabs(val) < 1e-9) return 0;
-    return (val > 0) ? 1 : 2;
-}
-
-int compare_points(const void *a, const void *b) {
-    Point *p1 = (Point *)a;
-    Point *p2 = (Point *)b;
-    if (p1->x != p2->x)
-        return (p1->x > p2->x) ? 1 : -1;
-    return (p1->y > p2->y) ? 1 : -1;
-}
-
-float calculate_polygon_area(Point points[], int n) {
-    float area = 0.0;
-    for (int i = 0; i < n; i++) {
-        int j = (i + 1) % n;
-        area += (points[i].x * points[j].y) - (points[j].x * points[i].y);
+// Lets the server hold as many connections as the hard fd limit allows
+void raise_fd_limit(void) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
     }
-    return fabs(area) / 2.0;
 }
 
-float convex_hull_array(Point points[], int n) {
-    if (n < 3) {
-        return calculate_polygon_area(points, n);
+// Replies never block the reactor thread, whatever the socket can't take is
+// queued by the reactor. A client that lets too much pile up is shut down,
+// its next read sees the end and cleans up.
+void send_reply(int fd, const char* msg, size_t len) {
+    if (reactorSend(getCurrentReactor(), fd, msg, len) < 0) {
+        shutdown(fd, SHUT_RDWR);
     }
+}
 
-    qsort(points, n, sizeof(Point), compare_points);
+// Only sets up the ingest, the points are taken by process_lines as they arrive
+void handle_newgraph(Connection* conn, int n) {
+    // The buffer grows with the points actually sent, not with the count claimed
+    int capacity = n < INGEST_INITIAL_POINTS ? n : INGEST_INITIAL_POINTS;
+    Point* points = (Point *)malloc(capacity * sizeof(Point));
+
+    // Without a buffer the n lines are still taken, then the graph is rejected
+    Ingest* ingest = &conn->ingest;
+    ingest->graph = conn->graph;
+    ingest->points = points;
+    ingest->expected = n;
+    ingest->received = 0;
+    ingest->capacity = points ? capacity : 0;
+    ingest->failure = points ? NULL : "Memory allocation failed\n";
+
+    send_reply(conn->fd, "Ready to receive points\n", 24);
+}
 
-    Point* hull = (Point*)malloc(n * 2 * sizeof(Point));
-    int k = 0;
+void free_ingest(Connection* conn) {
+    free(conn->ingest.points);
+    memset(&conn->ingest, 0, sizeof(Ingest));
+}
 
-    for (int i = 0; i < n; i++) {
-        while (k >= 2 && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
+// Adds one point line to the connection's Newgraph. After a bad point, or
+// when the buffer can't grow, the remaining lines are still taken as points,
+// so they aren't run as commands; the last one swaps the graph in or rejects it.
+void ingest_line(Connection* conn, const char* line, size_t len) {
+    Ingest* ingest = &conn->ingest;
+
+    if (ingest->failure) {
+        if (++ingest->received < ingest->expected) return;
+        const char* failure = ingest->failure;
+        free_ingest(conn);
+        send_reply(conn->fd, failure, strlen(failure));
+        return;
+    }
+    if (ingest->received == ingest->capacity) {
+        int capacity = ingest->capacity * 2;
+        if (capacity > ingest->expected || capacity < 0) capacity = ingest->expected;
+        Point* grown = realloc(ingest->points, capacity * sizeof(Point));
+        if (!grown) {
+            free(ingest->points);
+            ingest->points = NULL;
+            ingest->failure = "Memory allocation failed\n";
+            ingest_line(conn, line, len);
+            return;
+        }
+        ingest->points = grown;
+        ingest->capacity = capacity;
     }
 
-    for (int i = n-2, t = k+1; i >= 0; i--) {
-        while (k >= t && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
+    Point* point = &ingest->points[ingest->received];
+    if (!parsePoint(line, len, &point->x, &point->y)) {
+        free(ingest->points);
+        ingest->points = NULL;
+        ingest->failure = "Invalid point format\n";
+        ingest_line(conn, line, len);
+        return;
+    }
+    if (++ingest->received < ingest->expected) return;
+
+    // Readers of the graph see either the old points or all the new ones
+    int rc = setGraphPoints(ingest->graph, ingest->points, ingest->received);
+    ingest->points = NULL;
+    free_ingest(conn);
+    if (rc != 0) {
+        send_reply(conn->fd, "Memory allocation failed\n", 25);
+        return;
     }
+    send_reply(conn->fd, "Graph created successfully\n", 27);
+}
 
-    float area = calculate_polygon_area(hull, k-1);
-    free(hull);
-    return area;
+int handle_newpoint(Graph* graph, Coord x, Coord y) {
+    return addGraphPoint(graph, x, y);
 }
 
-void handle_newgraph(int n, int fd) {
-    if (graph_points != NULL) {
-        free(graph_points);
-        graph_points = NULL;
-    }
+bool handle_removepoint(Graph* graph, Coord x, Coord y) {
+    return removeGraphPoint(graph, x, y);
+}
 
-    num_points = n;
-    graph_points = (Point *)malloc(n * sizeof(Point));
-    if (!graph_points) {
-        send(fd, "Memory allocation failed\n", 25, 0);
+void reply_area(int fd, int n, double area) {
+    if (n == 0) {
+        send_reply(fd, "No points in graph\n", 20);
         return;
     }
+    char response[50];
+    snprintf(response, sizeof(response), "Area: %.1f\n", area);
+    send_reply(fd, response, strlen(response));
+}
 
-    send(fd, "Ready to receive points\n", 24, 0);
+// Runs on a worker thread
+void hull_task(void* arg) {
+    HullJob* job = (HullJob*)arg;
+    job->n = graphHullArea(job->graph, &job->area);
+    if (postToReactor(job->reactor, hull_done, job) != 0) {
+        fprintf(stderr, "Can't return the hull for %d\n", job->conn->fd);
+        free(job);
+    }
+}
 
-    for (int i = 0; i < n; i++) {
-        char buf[256];
-        int bytes_received = recv(fd, buf, sizeof(buf)-1, 0);
-        if (bytes_received <= 0) {
-            free(graph_points);
-            graph_points = NULL;
-            num_points = 0;
-            return;
-        }
-        buf[bytes_received] = '\0';
-
-        float x, y;
-        if (sscanf(buf, "%f,%f", &x, &y) != 2) {
-            send(fd, "Invalid point format\n", 21, 0);
-            free(graph_points);
-            graph_points = NULL;
-            num_points = 0;
+// Back on the client's reactor: reply, then carry on with what it sent meanwhile
+void hull_done(void* arg) {
+    HullJob* job = (HullJob*)arg;
+    Connection* conn = job->conn;
+
+    if (conn->closed) {
+        slabFree(connections, conn);
+    } else {
+        reply_area(conn->fd, job->n, job->area);
+        conn->busy = false;
+        setFdEvents(job->reactor, conn->fd, REACTOR_EVENT_READ);
+        process_lines(conn);
+    }
+    free(job);
+}
+
+// Hands the hull to a worker. Reading from the client pauses until the
+// reply is out, so replies keep the order of the commands.
+void handle_ch(Connection* conn) {
+    HullJob* job = malloc(sizeof(HullJob));
+    if (job) {
+        job->reactor = getCurrentReactor();
+        job->graph = conn->graph;
+        job->conn = conn;
+        if (trySubmitTask(workers, hull_task, job) == 0) {
+            conn->busy = true;
+            setFdEvents(job->reactor, conn->fd, 0);
             return;
         }
-        graph_points[i].x = x;
-        graph_points[i].y = y;
+        free(job);
     }
 
-    send(fd, "Graph created successfully\n", 27, 0);
+    // Workers swamped, compute here
+    double area = 0;
+    int n = graphHullArea(conn->graph, &area);
+    reply_area(conn->fd, n, area);
 }
 
-void handle_newpoint(float x, float y) {
-    num_points++;
-    graph_points = (Point *)realloc(graph_points, num_points * sizeof(Point));
-    graph_points[num_points - 1].x = x;
-    graph_points[num_points - 1].y = y;
+void handle_use(Connection* conn, const char* name) {
+    Graph* graph;
+    int result = findGraph(name, &graph);
+    if (result == GRAPH_TOO_MANY) {
+        send_reply(conn->fd, "Too many graphs\n", 16);
+        return;
+    }
+    if (!graph) {
+        send_reply(conn->fd, "Memory allocation failed\n", 25);
+        return;
+    }
+    conn->graph = graph;
+
+    char response[GRAPH_NAME_MAX + 16];
+    snprintf(response, sizeof(response), "Using graph %s\n", name);
+    send_reply(conn->fd, response, strlen(response));
 }
 
-bool handle_removepoint(float x, float y) {
-    for (int i = 0; i < num_points; i++) {
-        if (fabs(graph_points[i].x - x) < 1e-9 && fabs(graph_points[i].y - y) < 1e-9) {
-            for (int j = i; j < num_points - 1; j++) {
-                graph_points[j] = graph_points[j + 1];
-            }
-            num_points--;
-            graph_points = (Point *)realloc(graph_points, num_points * sizeof(Point));
-            return true;
-        }
+// Names a reactor callback from the exported symbols, falls back to its address
+static void callback_name(uint64_t func, char* name, size_t size) {
+    Dl_info info;
+    if (dladdr((void*)(uintptr_t)func, &info) && info.dli_sname) {
+        snprintf(name, size, "%s", info.dli_sname);
+    } else {
+        snprintf(name, size, "%#llx", (unsigned long long)func);
     }
-    return false;
 }
 
-void handle_ch(int fd) {
-    if (num_points == 0) {
-        send(fd, "No points in graph\n", 20, 0);
-        return;
+// Upper bound in us of the bucket holding the given fraction of calls
+static uint64_t histogram_percentile(const ReactorCallbackStats* stats, double fraction) {
+    uint64_t target = (uint64_t)(stats->calls * fraction);
+    uint64_t seen = 0;
+    for (int i = 0; i < REACTOR_STATS_BUCKETS; i++) {
+        seen += stats->histogram[i];
+        if (seen > target) return 1ull << i;
     }
-    float area = convex_hull_array(graph_points, num_points);
-    char response[50];
-    snprintf(response, sizeof(response), "Area: %.1f\n", area);
-    send(fd, response, strlen(response), 0);
+    return 1ull << (REACTOR_STATS_BUCKETS - 1);
 }
 
-void client_handler(int client_fd) {
-    char buf[256];
-    int bytes = recv(client_fd, buf, sizeof(buf) - 1, 0);
-    if (bytes <= 0) {
-        printf("Client %d disconnected\n", client_fd);
-        removeFd(getCurrentReactor(), client_fd);
-        close(client_fd);
+static void append(char* buf, size_t size, size_t* used, const char* format, ...) {
+    if (*used >= size) return;
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(buf + *used, size - *used, format, args);
+    va_end(args);
+    if (written > 0) *used += (size_t)written;
+}
+
+// One summary line per reactor, then one line per callback it ran
+void handle_stats(int fd) {
+    int count = getReactorGroupSize(reactors);
+    size_t size = 256 + (size_t)count * (REACTOR_STATS_CALLBACKS + 1) * 256;
+    char* buf = malloc(size);
+    if (!buf) {
+        send_reply(fd, "Memory allocation failed\n", 25);
         return;
     }
+    size_t used = 0;
+    char name[128];
+
+    for (int r = 0; r < count; r++) {
+        Reactor* reactor = getGroupReactor(reactors, r);
+        ReactorStats stats;
+        getReactorStats(reactor, &stats);
+
+        callback_name(stats.longest_stall_func, name, sizeof(name));
+        append(buf, size, &used,
+               "Reactor %d: %d fds, %llu waits, %.1f ms waiting (longest %.1f ms), "
+               "%llu events (avg %.2f, max %llu), %.1f ms in callbacks, longest stall %.3f ms in %s\n",
+               r, getReactorLoad(reactor), (unsigned long long)stats.iterations,
+               stats.wait_ns / 1e6, stats.max_wait_ns / 1e6, (unsigned long long)stats.ready,
+               stats.iterations ? (double)stats.ready / stats.iterations : 0.0,
+               (unsigned long long)stats.max_ready, stats.busy_ns / 1e6,
+               stats.longest_stall_ns / 1e6, stats.longest_stall_ns ? name : "-");
+
+        for (uint64_t i = 0; i < stats.callback_count && i < REACTOR_STATS_CALLBACKS; i++) {
+            const ReactorCallbackStats* callback = &stats.callbacks[i];
+            if (callback->calls == 0) continue;
+            callback_name(callback->func, name, sizeof(name));
+            append(buf, size, &used,
+                   "  %s: %llu calls, avg %.1f us, max %.1f us, p50 < %llu us, p99 < %llu us\n",
+                   name, (unsigned long long)callback->calls,
+                   callback->total_ns / 1e3 / callback->calls, callback->max_ns / 1e3,
+                   (unsigned long long)histogram_percentile(callback, 0.5),
+                   (unsigned long long)histogram_percentile(callback, 0.99));
+        }
+    }
+    append(buf, size, &used, "Connections: %d\nHull workers: %d queued\nEnd of stats\n",
+           getSlabCount(connections), getPendingTasks(workers));
+
+    send_reply(fd, buf, used < size ? used : size - 1);
+    free(buf);
+}
 
-    buf[bytes] = '\0';
+void handle_command(Command* cmd, Connection* conn) {
+    Graph* graph = conn->graph;
+    int client_fd = conn->fd;
 
-    if (strncmp(buf, "Newgraph", 8) == 0) {
-        int n;
-        if (sscanf(buf + 8, "%d", &n) == 1 && n > 0) {
-            handle_newgraph(n, client_fd);
+    switch (cmd->type) {
+    case CMD_NEWGRAPH:
+        if (cmd->valid) {
+            handle_newgraph(conn, cmd->n);
         } else {
-            send(client_fd, "Invalid Newgraph command\n", 26, 0);
+            send_reply(client_fd, "Invalid Newgraph command\n", 26);
         }
-    }
-    else if (strncmp(buf, "CH", 2) == 0) {
-        handle_ch(client_fd);
-    }
-    else if (strncmp(buf, "Newpoint", 8) == 0) {
-        float x, y;
-        if (sscanf(buf + 8, "%f,%f", &x, &y) == 2) {
-            handle_newpoint(x, y);
-            send(client_fd, "Point added\n", 13, 0);
+        break;
+    case CMD_CH:
+        handle_ch(conn);
+        break;
+    case CMD_NEWPOINT:
+        if (cmd->valid) {
+            if (handle_newpoint(graph, cmd->x, cmd->y) == 0) {
+                send_reply(client_fd, "Point added\n", 13);
+            } else {
+                send_reply(client_fd, "Max points reached\n", 20);
+            }
         } else {
-            send(client_fd, "Invalid Newpoint command\n", 27, 0);
+            send_reply(client_fd, "Invalid Newpoint command\n", 27);
         }
-    }
-    else if (strncmp(buf, "Removepoint", 11) == 0) {
-        float x, y;
-        if (sscanf(buf + 11, "%f,%f", &x, &y) == 2) {
-            if (handle_removepoint(x, y)) {
-                send(client_fd, "Point removed\n", 15, 0);
+        break;
+    case CMD_REMOVEPOINT:
+        if (cmd->valid) {
+            if (handle_removepoint(graph, cmd->x, cmd->y)) {
+                send_reply(client_fd, "Point removed\n", 15);
             } else {
-                send(client_fd, "Point not found\n", 18, 0);
+                send_reply(client_fd, "Point not found\n", 18);
             }
         } else {
-            send(client_fd, "Invalid Removepoint command\n", 30, 0);
+            send_reply(client_fd, "Invalid Removepoint command\n", 30);
         }
+        break;
+    case CMD_USE:
+        if (cmd->valid) {
+            handle_use(conn, cmd->name);
+        } else {
+            send_reply(client_fd, "Invalid Use command\n", 20);
+        }
+        break;
+    case CMD_STATS:
+        handle_stats(client_fd);
+        break;
+    default:
+        send_reply(client_fd, "Unknown command\n", 17);
+        break;
+    }
+}
+
+// Runs on the reactor that watches the connection
+void close_client(Connection* conn) {
+    Reactor* reactor = getCurrentReactor();
+    removeFd(reactor, conn->fd);
+    if (conn->timer) {
+        cancelTimer(reactor, conn->timer);
+        conn->timer = 0;
+    }
+    free_ingest(conn);
+    free(conn->reader);
+    conn->reader = NULL;
+    close(conn->fd);
+
+    // A worker still holds it, the hull's reply frees it instead
+    if (conn->busy) {
+        conn->closed = true;
+    } else {
+        slabFree(connections, conn);
     }
-    else {
-        send(client_fd, "Unknown command\n", 17, 0);
+}
+
+// One timer per connection: instead of being moved on every command it
+// fires once per timeout and re-arms itself for whatever is left
+void idle_check(void* arg) {
+    Connection* conn = (Connection*)arg;
+    Reactor* reactor = getCurrentReactor();
+    uint64_t idle = getReactorTime(reactor) - conn->active;
+
+    if (idle >= idle_timeout_ms) {
+        printf("Client %d idle, closing\n", conn->fd);
+        conn->timer = 0;
+        close_client(conn);
+        return;
+    }
+    conn->timer = addTimer(reactor, idle_timeout_ms - (unsigned)idle, idle_check, conn);
+}
+
+// Allocates the line buffer on the first input, closes the client without one
+bool ensure_reader(Connection* conn) {
+    if (conn->reader) return true;
+    conn->reader = malloc(sizeof(LineReader));
+    if (!conn->reader) {
+        fprintf(stderr, "Out of memory, dropping %d\n", conn->fd);
+        close_client(conn);
+        return false;
+    }
+    initLineReader(conn->reader);
+    return true;
+}
+
+void client_handler(int client_fd, int events, void* ctx) {
+    (void)events;
+    Connection* conn = (Connection*)ctx;
+    if (!ensure_reader(conn)) return;
+    int bytes = fillLineReader(conn->reader, client_fd);
+    if (bytes <= 0) {
+        printf("Client %d disconnected\n", client_fd);
+        close_client(conn);
+        return;
+    }
+    conn->active = getReactorTime(getCurrentReactor());
+    process_lines(conn);
+}
+
+// On the io_uring backend the reactor did the recv. Lines are taken until a
+// hull goes to a worker; the connection is paused then and the reactor hands
+// over the rest once hull_done resumes it.
+size_t client_received(int client_fd, const char* data, size_t len, void* ctx) {
+    Connection* conn = (Connection*)ctx;
+    if (len == 0) {
+        printf("Client %d disconnected\n", client_fd);
+        close_client(conn);
+        return 0;
+    }
+    if (!ensure_reader(conn)) return len;
+    conn->active = getReactorTime(getCurrentReactor());
+
+    size_t taken = 0;
+    while (taken < len && !conn->busy) {
+        taken += feedLineReader(conn->reader, data + taken, len - taken);
+        process_lines(conn);
+    }
+    return taken;
+}
+
+// Runs every complete line until a command goes to a worker,
+// a partial line waits for the next read. During a Newgraph lines are points.
+void process_lines(Connection* conn) {
+    char* line;
+    size_t len;
+    while (!conn->busy && (line = nextLine(conn->reader, &len)) != NULL) {
+        if (conn->ingest.expected) {
+            ingest_line(conn, line, len);
+            continue;
+        }
+        Command cmd;
+        parseCommand(line, len, &cmd);
+        handle_command(&cmd, conn);
     }
 }
 
@@ -221,16 +522,101 @@ void accept_handler(int listen_fd) {
         perror("accept");
         return;
     }
+    add_client(client_fd);
+}
+
+// A connection the multishot accept of the io_uring backend took
+void accept_done(int listen_fd, int client_fd, void* ctx) {
+    (void)listen_fd;
+    (void)ctx;
+    if (client_fd == -1) {
+        perror("accept");
+        return;
+    }
+    add_client(client_fd);
+}
+
+void add_client(int client_fd) {
+    Connection* conn = slabAlloc(connections);
+    if (!conn) {
+        fprintf(stderr, "Out of memory, dropping %d\n", client_fd);
+        close(client_fd);
+        return;
+    }
+    conn->fd = client_fd;
+    conn->graph = getGraph(DEFAULT_GRAPH);
+    if (!conn->graph) {
+        // No reactor watches it yet, the reply goes out directly or not at all
+        send(client_fd, "Memory allocation failed\n", 25, MSG_DONTWAIT);
+        slabFree(connections, conn);
+        close(client_fd);
+        return;
+    }
+
+    // The timer goes in first, the other reactor may close the fd as soon as it watches it
+    Reactor* reactor = nextReactor(reactors);
+    conn->active = getReactorTime(reactor);
+    if (idle_timeout_ms) {
+        conn->timer = addTimer(reactor, idle_timeout_ms, idle_check, conn);
+    }
 
+    int added;
+    if (getReactorBackend(reactor) == REACTOR_BACKEND_IO_URING) {
+        added = registerCompletionHandler(reactor, client_fd, client_received, conn);
+    } else {
+        added = addFdContext(reactor, client_fd, REACTOR_EVENT_READ, client_handler, conn);
+    }
+    if (added != 0) {
+        fprintf(stderr, "Reactor can't watch %d, dropping it\n", client_fd);
+        if (conn->timer) cancelTimer(reactor, conn->timer);
+        slabFree(connections, conn);
+        close(client_fd);
+        return;
+    }
     printf("New connection: %d\n", client_fd);
-    addFd(getCurrentReactor(), client_fd, client_handler);
 }
 
-int main(void) {
+int main(int argc, char* argv[]) {
     int sockfd;
     struct addrinfo hints, *servinfo, *p;
     int yes=1;
     int rv;
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int worker_count = count;
+    ReactorBalance balance = REACTOR_BALANCE_ROUND_ROBIN;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:b:i:w:")) != -1) {
+        switch (opt) {
+        case 'r':
+            count = atoi(optarg);
+            break;
+        case 'b':
+            if (strcmp(optarg, "rr") == 0) {
+                balance = REACTOR_BALANCE_ROUND_ROBIN;
+            } else if (strcmp(optarg, "least") == 0) {
+                balance = REACTOR_BALANCE_LEAST_LOADED;
+            } else {
+                count = 0;
+            }
+            break;
+        case 'i':
+            idle_timeout_ms = (unsigned)atoi(optarg) * 1000;
+            break;
+        case 'w':
+            worker_count = atoi(optarg);
+            break;
+        default:
+            count = 0;
+            break;
+        }
+    }
+    if (count < 1 || worker_count < 1) {
+        fprintf(stderr, "Usage: %s [-r reactors] [-b rr|least] [-i idle_seconds] [-w hull_workers]\n", argv[0]);
+        exit(1);
+    }
+
+    raise_fd_limit();
 
     memset(&hints, 0, sizeof hints);
     hints.ai_family = AF_UNSPEC;
@@ -276,19 +662,38 @@ int main(void) {
 
     printf("server: waiting for connections...\n");
 
-    Reactor* reactor = createReactor();
-    if (!reactor) {
-        fprintf(stderr, "Failed to create reactor\n");
+    connections = createSlab(sizeof(Connection), CONNECTIONS_PER_CHUNK);
+    workers = createThreadPool(worker_count, HULL_QUEUE_DEPTH);
+    if (!connections || !workers) {
+        fprintf(stderr, "Failed to start hull workers\n");
         exit(1);
     }
 
-    addFd(reactor, sockfd, accept_handler);
+    // One event loop per core, each with its own thread and fds
+    reactors = createReactorGroup(count, balance);
+    if (!reactors) {
+        fprintf(stderr, "Failed to create reactors\n");
+        exit(1);
+    }
+    Reactor* reactor = getGroupReactor(reactors, 0);
+    printf("server: %d %s reactors, %s balancing\n", count,
+           reactorBackendName(getReactorBackend(reactor)),
+           balance == REACTOR_BALANCE_LEAST_LOADED ? "least loaded" : "round-robin");
+
+    // The io_uring backend takes every pending connection with one multishot accept
+    if (getReactorBackend(reactor) == REACTOR_BACKEND_IO_URING) {
+        addAcceptHandler(reactor, sockfd, accept_done, NULL);
+    } else {
+        addFd(reactor, sockfd, accept_handler);
+    }
 
     while (1) {
         pause(); // keep main alive
     }
 
-    stopReactor(reactor);
-    if (graph_points) free(graph_points);
+    stopReactorGroup(reactors);
+    destroyThreadPool(workers);
+    destroySlab(connections);
+    destroyGraphs();
     return 0;
 }
\ No newline at end of file
@@ -4,12 +4,7 @@
 #include <math.h>
 #include <time.h>
 #include <stdbool.h>
-
-// Structure to represent a 2D point with x and y coordinates
-typedef struct {
-    float x;
-    float y;
-} Point;
+#include "geom.h"
 
 // Node structure for linked list implementation
 typedef struct Node {
@@ -29,87 +24,6 @@ Node* create_node(Point p) {
     return new_node;
 }
 
-/**
- * Determines the orientation of three ordered points (p, q, r)
- * @param p First point
- * @param q Second point
- * @param r Third point
- * @return 0 if colinear, 1 if clockwise, 2 if counterclockwise
- */
-int orientation(Point p, Point q, Point r) {
-    float val = (q.y - p.y) * (r.x - q.x) - (q.x - p.x) * (r.y - q.y);
-    if (fabs(val) < 1e-9) return 0;   // Colinear
-    return (val > 0) ? 1 : 2;          // Clockwise or counterclockwise
-}
-
-/**
- * Comparison function for qsort() to sort points
- * First by x-coordinate, then by y-coordinate
- * @param a First point to compare
- * @param b Second point to compare
- * @return Comparison result for sorting
- */
-int compare_points(const void *a, const void *b) {
-    Point *p1 = (Point *)a;
-    Point *p2 = (Point *)b;
-    if (p1->x != p2->x)
-        return (p1->x > p2->x) ? 1 : -1;
-    return (p1->y > p2->y) ? 1 : -1;
-}
-
-/**
- * Calculates the area of a polygon using the shoelace formula
- * @param points Array of points representing the polygon
- * @param n Number of points
- * @return Calculated area of the polygon
- */
-float calculate_polygon_area(Point points[], int n) {
-    float area = 0.0;
-    for (int i = 0; i < n; i++) {
-        int j = (i + 1) % n;
-        area += (points[i].x * points[j].y) - (points[j].x * points[i].y);
-    }
-    return fabs(area) / 2.0;
-}
-
-/**
- * Computes convex hull using array implementation
- * @param points Array of input points
- * @param n Number of points
- * @return Area of the convex hull
- */
-float convex_hull_array(Point points[], int n) {
-    if (n < 3) {
-        return calculate_polygon_area(points, n);
-    }
-
-    // Sort points by x-coordinate (then y-coordinate)
-    qsort(points, n, sizeof(Point), compare_points);
-
-    Point* hull = (Point*)malloc(n * 2 * sizeof(Point));
-    int k = 0;
-
-    // Build lower hull
-    for (int i = 0; i < n; i++) {
-        // Remove points that would create clockwise turn
-        while (k >= 2 && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
-    }
-
-    // Build upper hull
-    for (int i = n-2, t = k+1; i >= 0; i--) {
-        // Remove points that would create clockwise turn
-        while (k >= t && orientation(hull[k-2], hull[k-1], points[i]) != 2)
-            k--;
-        hull[k++] = points[i];
-    }
-
-    float area = calculate_polygon_area(hull, k-1);
-    free(hull);
-    return area;
-}
-
 // Global variables to store the current graph state
 Point* points = NULL;    // Dynamic array of points
 int num_points = 0;      // Current number of points
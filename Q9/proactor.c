@@ -5,23 +5,33 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <sys/socket.h>
+#include "affinity.h"
 
 // Struct for initial accept thread setup
 typedef struct {
     int sockfd;
     proactorFunc func;
+    Admission* connections;   // NULL when unlimited
+    proactorFunc reject;
 } ProactorArgs;
 
 // Struct passed to client thread via adapter
 typedef struct {
     proactorFunc func;
     int fd;
+    Admission* connections;
 } TaskArgs;
 
+// Threads started so far, each takes the next CPU of its list
+static int accept_threads = 0;
+static int client_threads = 0;
+
 // Adapter function that bridges void* thread call to int-based handler
 void* thread_adapter(void* arg) {
     TaskArgs* args = (TaskArgs*)arg;
+    pinThread(WORKER_CPUS, __atomic_fetch_add(&client_threads, 1, __ATOMIC_RELAXED));
     void* result = args->func(args->fd);  // call the original user function
+    if (args->connections) releaseAdmission(args->connections);
     free(args);  // clean up
     return result;
 }
@@ -31,7 +41,10 @@ void* accept_loop(void* arg) {
     ProactorArgs* args = (ProactorArgs*)arg;
     int sockfd = args->sockfd;
     proactorFunc func = args->func;
+    Admission* connections = args->connections;
+    proactorFunc reject = args->reject;
     free(args);
+    pinThread(ACCEPT_CPUS, __atomic_fetch_add(&accept_threads, 1, __ATOMIC_RELAXED));
 
     while (1) {
         struct sockaddr_storage their_addr;
@@ -42,13 +55,29 @@ void* accept_loop(void* arg) {
             continue;
         }
         printf("New connection accepted: socket %d\n", client_fd);
+        // Past the limit the client is turned away without a thread
+        if (connections && !tryAdmit(connections)) {
+            reject(client_fd);
+            continue;
+        }
         // Prepare args for the new client thread
         TaskArgs* task = malloc(sizeof(TaskArgs));
-        task->func = func;
-        task->fd = client_fd;
-
         pthread_t tid;
-        pthread_create(&tid, NULL, thread_adapter, task);
+        if (task) {
+            task->func = func;
+            task->fd = client_fd;
+            task->connections = connections;
+        }
+        if (!task || pthread_create(&tid, NULL, thread_adapter, task) != 0) {
+            free(task);
+            if (connections) releaseAdmission(connections);
+            if (reject) {
+                reject(client_fd);
+            } else {
+                close(client_fd);
+            }
+            continue;
+        }
         pthread_detach(tid);
     }
 
@@ -56,10 +85,17 @@ void* accept_loop(void* arg) {
 }
 
 pthread_t startProactor(int sockfd, proactorFunc handler) {
+    return startProactorLimited(sockfd, handler, NULL, NULL);
+}
+
+pthread_t startProactorLimited(int sockfd, proactorFunc handler,
+                               Admission* connections, proactorFunc reject) {
     pthread_t accept_tid;
     ProactorArgs* args = malloc(sizeof(ProactorArgs));
     args->sockfd = sockfd;
     args->func = handler;
+    args->connections = connections;
+    args->reject = reject;
     pthread_create(&accept_tid, NULL, accept_loop, args);
     return accept_tid;
 }
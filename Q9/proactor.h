@@ -2,10 +2,17 @@
 #define PROACTOR_H
 
 #include <pthread.h>
+#include "admission.h"
 
 typedef void* (*proactorFunc)(int sockfd);
 
 pthread_t startProactor(int listen_sockfd, proactorFunc handler);
+
+// Like startProactor, but a connection only gets a thread if it fits in
+// connections (shared by every proactor given it); otherwise reject runs on
+// the accept thread and must answer quickly and close the socket
+pthread_t startProactorLimited(int listen_sockfd, proactorFunc handler,
+                               Admission* connections, proactorFunc reject);
 int stopProactor(pthread_t tid);
 
 #endif // PROACTOR_H
@@ -0,0 +1,79 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "command.h"
+
+#define NUM_LINES 1000000
+
+// The strncmp/sscanf chain the servers used before Common/command.c
+static int legacy_dispatch(const char* buf, float* x, float* y, int* n) {
+    if (strncmp(buf, "Newgraph", 8) == 0) {
+        return sscanf(buf + 8, "%d", n) == 1 ? CMD_NEWGRAPH : CMD_UNKNOWN;
+    } else if (strncmp(buf, "CH", 2) == 0) {
+        return CMD_CH;
+    } else if (strncmp(buf, "Newpoint", 8) == 0) {
+        return sscanf(buf + 8, "%f,%f", x, y) == 2 ? CMD_NEWPOINT : CMD_UNKNOWN;
+    } else if (strncmp(buf, "Removepoint", 11) == 0) {
+        return sscanf(buf + 11, "%f,%f", x, y) == 2 ? CMD_REMOVEPOINT : CMD_UNKNOWN;
+    }
+    return CMD_UNKNOWN;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 5;
+    char (*lines)[64] = malloc(NUM_LINES * sizeof(*lines));
+    size_t* lengths = malloc(NUM_LINES * sizeof(size_t));
+    unsigned int seed = 42;
+
+    // Same mix as the default loadgen workload
+    for (int i = 0; i < NUM_LINES; i++) {
+        int r = rand_r(&seed) % 100;
+        float x = (rand_r(&seed) % 10000) / 10.0f;
+        float y = (rand_r(&seed) % 10000) / 10.0f;
+        if (r < 60) snprintf(lines[i], sizeof lines[i], "Newpoint %.1f,%.1f", x, y);
+        else if (r < 80) snprintf(lines[i], sizeof lines[i], "Removepoint %.1f,%.1f", x, y);
+        else if (r < 99) snprintf(lines[i], sizeof lines[i], "CH");
+        else snprintf(lines[i], sizeof lines[i], "Newgraph %d", r);
+        lengths[i] = strlen(lines[i]);
+    }
+
+    long checksum_legacy = 0, checksum_new = 0;
+    double best_legacy = 1e9, best_new = 1e9;
+
+    for (int round = 0; round < rounds; round++) {
+        float x = 0, y = 0;
+        int n = 0;
+        double start = now_sec();
+        for (int i = 0; i < NUM_LINES; i++) {
+            checksum_legacy += legacy_dispatch(lines[i], &x, &y, &n) + (long)x;
+        }
+        double elapsed = now_sec() - start;
+        if (elapsed < best_legacy) best_legacy = elapsed;
+
+        Command cmd;
+        start = now_sec();
+        for (int i = 0; i < NUM_LINES; i++) {
+            parseCommand(lines[i], lengths[i], &cmd);
+            checksum_new += cmd.type + (long)cmd.x;
+        }
+        elapsed = now_sec() - start;
+        if (elapsed < best_new) best_new = elapsed;
+    }
+
+    printf("strncmp + sscanf:  %12.0f commands/s\n", NUM_LINES / best_legacy);
+    printf("parseCommand:      %12.0f commands/s\n", NUM_LINES / best_new);
+    printf("speedup:           %12.1fx\n", best_legacy / best_new);
+    if (checksum_legacy != checksum_new) printf("(results differ: %ld vs %ld)\n", checksum_legacy, checksum_new);
+
+    free(lengths);
+    free(lines);
+    return 0;
+}
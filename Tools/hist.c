@@ -0,0 +1,45 @@
+#include "hist.h"
+
+static int hist_index(uint64_t value) {
+    if (value < HIST_SUB) return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - HIST_SUB_BITS;
+    return (shift + 1) * HIST_SUB + (int)((value >> shift) - HIST_SUB);
+}
+
+// Highest value that lands in bucket index
+static uint64_t hist_value(int index) {
+    if (index < HIST_SUB) return (uint64_t)index;
+    int shift = index / HIST_SUB - 1;
+    uint64_t sub = (uint64_t)(index % HIST_SUB + HIST_SUB);
+    return ((sub + 1) << shift) - 1;
+}
+
+void hist_record(Histogram* hist, uint64_t value) {
+    hist->buckets[hist_index(value)]++;
+    hist->count++;
+    if (value > hist->max) hist->max = value;
+}
+
+void hist_merge(Histogram* dst, const Histogram* src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const Histogram* hist, double percentile) {
+    if (hist->count == 0) return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * hist->count + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t value = hist_value(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
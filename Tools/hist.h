@@ -0,0 +1,28 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+
+// Log-linear latency histogram in the style of HdrHistogram: values below
+// 2^HIST_SUB_BITS are exact, larger ones keep HIST_SUB_BITS significant bits
+// (under 2% relative error) for the whole 64-bit range.
+#define HIST_SUB_BITS 6
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+typedef struct {
+    uint64_t buckets[HIST_BUCKETS];
+    uint64_t count;
+    uint64_t max;
+} Histogram;
+
+// Adds one value to the histogram
+void hist_record(Histogram* hist, uint64_t value);
+
+// Adds all values of src to dst
+void hist_merge(Histogram* dst, const Histogram* src);
+
+// Returns the value at the given percentile (0-100)
+uint64_t hist_percentile(const Histogram* hist, double percentile);
+
+#endif
@@ -0,0 +1,513 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "hist.h"
+
+#define MAX_LINE 256
+#define RECENT_POINTS 64
+#define MAX_PENDING 65536
+#define CONNECT_TIMEOUT_MS 2000
+
+enum { CMD_NEWPOINT, CMD_REMOVEPOINT, CMD_CH, CMD_NEWGRAPH, CMD_COUNT };
+#define CMD_SETUP CMD_COUNT   // Use command sent before the measurement starts
+static const char* command_names[CMD_COUNT] = { "Newpoint", "Removepoint", "CH", "Newgraph" };
+
+enum { CONN_CLOSED, CONN_IDLE, CONN_WAIT };
+
+typedef struct {
+    float x;
+    float y;
+} Point;
+
+// One client connection driven by a worker thread
+typedef struct {
+    int fd;
+    int state;
+    int command;
+    int newgraph_stage;
+    uint64_t start_ns;
+    char rbuf[4096];
+    int rlen;
+    Point recent[RECENT_POINTS];
+    int recent_count;
+    unsigned int seed;
+} Conn;
+
+// Settings shared by all worker threads
+typedef struct {
+    const char* host;
+    const char* port;
+    int connections;
+    int threads;
+    double duration;
+    double rate;
+    int weights[CMD_COUNT];
+    int graph_size;
+    int graphs;
+} Config;
+
+typedef struct {
+    int id;
+    Conn* conns;
+    int num_conns;
+    double rate;
+    Histogram hist[CMD_COUNT];
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t busy;
+    uint64_t connect_failures;
+    uint64_t dropped;
+    pthread_t tid;
+} Worker;
+
+static Config config;
+static uint64_t start_time_ns;
+static uint64_t end_time_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int connect_to_server(void) {
+    struct addrinfo hints, *servinfo, *p;
+    int sockfd = -1;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(config.host, config.port, &hints, &servinfo) != 0) return -1;
+
+    for (p = servinfo; p != NULL; p = p->ai_next) {
+        sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (sockfd == -1) continue;
+
+        // Connect without blocking so a server that stops accepting can't hang us
+        int flags = fcntl(sockfd, F_GETFL, 0);
+        fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+        int rv = connect(sockfd, p->ai_addr, p->ai_addrlen);
+        if (rv == -1 && errno == EINPROGRESS) {
+            struct pollfd pfd = { .fd = sockfd, .events = POLLOUT };
+            int err = 0;
+            socklen_t len = sizeof err;
+            if (poll(&pfd, 1, CONNECT_TIMEOUT_MS) == 1 &&
+                getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+                rv = 0;
+            }
+        }
+        if (rv == 0) {
+            fcntl(sockfd, F_SETFL, flags);
+            int yes = 1;
+            setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof yes);
+            break;
+        }
+        close(sockfd);
+        sockfd = -1;
+    }
+
+    freeaddrinfo(servinfo);
+    return sockfd;
+}
+
+static int send_all(int fd, const char* buf, int len) {
+    int total = 0;
+    while (total < len) {
+        int n = send(fd, buf + total, len - total, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        total += n;
+    }
+    return 0;
+}
+
+static float random_coord(Conn* conn) {
+    return (float)(rand_r(&conn->seed) % 10000) / 10.0f;
+}
+
+static int pick_command(Conn* conn) {
+    int total = 0;
+    for (int i = 0; i < CMD_COUNT; i++) total += config.weights[i];
+    int r = rand_r(&conn->seed) % total;
+    for (int i = 0; i < CMD_COUNT; i++) {
+        if (r < config.weights[i]) return i;
+        r -= config.weights[i];
+    }
+    return CMD_CH;
+}
+
+static void close_conn(Worker* worker, Conn* conn) {
+    close(conn->fd);
+    conn->fd = -1;
+    conn->state = CONN_CLOSED;
+    worker->errors++;
+}
+
+// Sends the next command on an idle connection, start is the intended send time
+static void issue_command(Worker* worker, Conn* conn, uint64_t start) {
+    char line[MAX_LINE];
+    int len = 0;
+    int command = pick_command(conn);
+
+    switch (command) {
+    case CMD_NEWPOINT: {
+        Point p = { random_coord(conn), random_coord(conn) };
+        len = snprintf(line, sizeof line, "Newpoint %.1f,%.1f\n", p.x, p.y);
+        conn->recent[conn->recent_count % RECENT_POINTS] = p;
+        conn->recent_count++;
+        break;
+    }
+    case CMD_REMOVEPOINT: {
+        // Prefer points this connection added so removes mostly hit
+        Point p = { random_coord(conn), random_coord(conn) };
+        if (conn->recent_count > 0) {
+            int limit = conn->recent_count < RECENT_POINTS ? conn->recent_count : RECENT_POINTS;
+            p = conn->recent[rand_r(&conn->seed) % limit];
+        }
+        len = snprintf(line, sizeof line, "Removepoint %.1f,%.1f\n", p.x, p.y);
+        break;
+    }
+    case CMD_CH:
+        len = snprintf(line, sizeof line, "CH\n");
+        break;
+    case CMD_NEWGRAPH:
+        len = snprintf(line, sizeof line, "Newgraph %d\n", config.graph_size);
+        conn->newgraph_stage = 1;
+        break;
+    }
+
+    conn->command = command;
+    conn->start_ns = start;
+    conn->state = CONN_WAIT;
+    if (send_all(conn->fd, line, len) == -1) close_conn(worker, conn);
+}
+
+static void send_graph_points(Worker* worker, Conn* conn) {
+    char* payload = malloc((size_t)config.graph_size * 24);
+    int len = 0;
+    for (int i = 0; i < config.graph_size; i++) {
+        len += sprintf(payload + len, "%.1f,%.1f\n", random_coord(conn), random_coord(conn));
+    }
+    if (send_all(conn->fd, payload, len) == -1) close_conn(worker, conn);
+    free(payload);
+}
+
+// Handles one complete reply line, returns true when the command finished
+static bool handle_line(Worker* worker, Conn* conn, const char* line) {
+    // Turned away by admission control, counted apart and kept out of the latencies
+    if (strncmp(line, "Busy", 4) == 0) {
+        worker->busy++;
+        conn->newgraph_stage = 0;
+        conn->state = CONN_IDLE;
+        return true;
+    }
+
+    if (strncmp(line, "Invalid", 7) == 0 || strncmp(line, "Unknown", 7) == 0 ||
+        strncmp(line, "Memory", 6) == 0) {
+        worker->errors++;
+    }
+
+    if (conn->command == CMD_SETUP) {
+        conn->state = CONN_IDLE;
+        return true;
+    }
+
+    if (conn->command == CMD_NEWGRAPH && conn->newgraph_stage == 1) {
+        conn->newgraph_stage = 2;
+        send_graph_points(worker, conn);
+        return false;
+    }
+
+    uint64_t end = now_ns();
+    if (end <= end_time_ns) {
+        hist_record(&worker->hist[conn->command], (end - conn->start_ns) / 1000);
+        worker->completed++;
+    }
+    conn->state = CONN_IDLE;
+    return true;
+}
+
+static void read_replies(Worker* worker, Conn* conn) {
+    int n = recv(conn->fd, conn->rbuf + conn->rlen, sizeof(conn->rbuf) - conn->rlen - 1, 0);
+    if (n <= 0) {
+        close_conn(worker, conn);
+        return;
+    }
+
+    // Some servers send the terminating NUL along with the reply, drop it
+    for (int i = conn->rlen; i < conn->rlen + n; i++) {
+        if (conn->rbuf[i] == '\0') conn->rbuf[i] = '\r';
+    }
+    conn->rlen += n;
+    conn->rbuf[conn->rlen] = '\0';
+
+    char* line = conn->rbuf;
+    char* nl;
+    while ((nl = strchr(line, '\n')) != NULL) {
+        *nl = '\0';
+        while (*line == '\r') line++;
+        if (conn->state == CONN_WAIT) handle_line(worker, conn, line);
+        line = nl + 1;
+    }
+    conn->rlen -= line - conn->rbuf;
+    memmove(conn->rbuf, line, conn->rlen);
+    if (conn->rlen >= (int)sizeof(conn->rbuf) - 1) conn->rlen = 0;
+}
+
+static void* worker_loop(void* arg) {
+    Worker* worker = (Worker*)arg;
+    struct pollfd* pfds = malloc(worker->num_conns * sizeof(struct pollfd));
+    uint64_t* pending = malloc(MAX_PENDING * sizeof(uint64_t));
+    int pending_head = 0, pending_count = 0;
+    uint64_t interval = worker->rate > 0 ? (uint64_t)(1e9 / worker->rate) : 0;
+    uint64_t next_send = start_time_ns;
+
+    for (int i = 0; i < worker->num_conns; i++) {
+        Conn* conn = &worker->conns[i];
+        conn->seed = (unsigned int)(worker->id * 7919 + i + 1);
+        conn->fd = connect_to_server();
+        if (conn->fd == -1) {
+            conn->state = CONN_CLOSED;
+            worker->connect_failures++;
+            continue;
+        }
+        conn->state = CONN_IDLE;
+        if (config.graphs > 0) {
+            char line[MAX_LINE];
+            int len = snprintf(line, sizeof line, "Use g%d\n", (worker->id + i * config.threads) % config.graphs);
+            conn->command = CMD_SETUP;
+            conn->start_ns = now_ns();
+            conn->state = CONN_WAIT;
+            if (send_all(conn->fd, line, len) == -1) close_conn(worker, conn);
+        }
+    }
+
+    while (1) {
+        uint64_t now = now_ns();
+        if (now >= end_time_ns) break;
+
+        // Open loop: queue sends at their intended times, latency counts from then
+        if (interval > 0) {
+            while (next_send <= now) {
+                if (pending_count < MAX_PENDING) {
+                    pending[(pending_head + pending_count) % MAX_PENDING] = next_send;
+                    pending_count++;
+                } else {
+                    worker->dropped++;
+                }
+                next_send += interval;
+            }
+        }
+
+        int nfds = 0;
+        for (int i = 0; i < worker->num_conns; i++) {
+            Conn* conn = &worker->conns[i];
+            if (conn->state == CONN_IDLE && now >= start_time_ns) {
+                if (interval == 0) {
+                    issue_command(worker, conn, now);
+                } else if (pending_count > 0) {
+                    issue_command(worker, conn, pending[pending_head]);
+                    pending_head = (pending_head + 1) % MAX_PENDING;
+                    pending_count--;
+                }
+            }
+            if (conn->state != CONN_CLOSED) {
+                pfds[nfds].fd = conn->fd;
+                pfds[nfds].events = POLLIN;
+                nfds++;
+            }
+        }
+        if (nfds == 0) break;
+
+        // Sleep until the next scheduled send with sub-millisecond precision
+        uint64_t timeout_ns = 10000000ull;
+        if (interval > 0 && next_send > now && next_send - now < timeout_ns) {
+            timeout_ns = next_send - now;
+        }
+        struct timespec timeout = { .tv_sec = 0, .tv_nsec = (long)timeout_ns };
+        if (ppoll(pfds, nfds, &timeout, NULL) <= 0) continue;
+
+        for (int i = 0, j = 0; i < worker->num_conns && j < nfds; i++) {
+            Conn* conn = &worker->conns[i];
+            if (conn->state == CONN_CLOSED || conn->fd != pfds[j].fd) continue;
+            if (pfds[j].revents & (POLLIN | POLLHUP | POLLERR)) read_replies(worker, conn);
+            j++;
+        }
+    }
+
+    for (int i = 0; i < worker->num_conns; i++) {
+        if (worker->conns[i].fd != -1) close(worker->conns[i].fd);
+    }
+    free(pending);
+    free(pfds);
+    return NULL;
+}
+
+static bool parse_mix(const char* spec) {
+    char* copy = strdup(spec);
+    char* save = NULL;
+    memset(config.weights, 0, sizeof config.weights);
+
+    for (char* tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char* eq = strchr(tok, '=');
+        if (!eq) {
+            free(copy);
+            return false;
+        }
+        *eq = '\0';
+        int found = -1;
+        for (int i = 0; i < CMD_COUNT; i++) {
+            if (strcasecmp(tok, command_names[i]) == 0) found = i;
+        }
+        if (found == -1) {
+            free(copy);
+            return false;
+        }
+        config.weights[found] = atoi(eq + 1);
+    }
+    free(copy);
+
+    int total = 0;
+    for (int i = 0; i < CMD_COUNT; i++) total += config.weights[i];
+    return total > 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -H host      server host (default 127.0.0.1)\n"
+        "  -p port      server port (default 9034)\n"
+        "  -c conns     concurrent connections (default 16)\n"
+        "  -t threads   client threads (default 2)\n"
+        "  -d seconds   test duration (default 10)\n"
+        "  -r rate      open-loop rate in commands/s, 0 = closed loop (default 0)\n"
+        "  -m mix       command weights (default newpoint=60,removepoint=20,ch=20,newgraph=0)\n"
+        "  -n points    points sent per Newgraph (default 100)\n"
+        "  -g graphs    spread connections over this many named graphs (default 0 = default graph)\n"
+        "  -s           print one CSV summary line instead of the report\n",
+        prog);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    bool csv = false;
+    int opt;
+
+    config.host = "127.0.0.1";
+    config.port = "9034";
+    config.connections = 16;
+    config.threads = 2;
+    config.duration = 10;
+    config.rate = 0;
+    config.graph_size = 100;
+    config.graphs = 0;
+    parse_mix("newpoint=60,removepoint=20,ch=20,newgraph=0");
+
+    while ((opt = getopt(argc, argv, "H:p:c:t:d:r:m:n:g:s")) != -1) {
+        switch (opt) {
+        case 'H': config.host = optarg; break;
+        case 'p': config.port = optarg; break;
+        case 'c': config.connections = atoi(optarg); break;
+        case 't': config.threads = atoi(optarg); break;
+        case 'd': config.duration = atof(optarg); break;
+        case 'r': config.rate = atof(optarg); break;
+        case 'm': if (!parse_mix(optarg)) usage(argv[0]); break;
+        case 'n': config.graph_size = atoi(optarg); break;
+        case 'g': config.graphs = atoi(optarg); break;
+        case 's': csv = true; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (config.connections < 1 || config.threads < 1 || config.duration <= 0 || config.graph_size < 1) {
+        usage(argv[0]);
+    }
+    if (config.threads > config.connections) config.threads = config.connections;
+
+    Conn* conns = calloc(config.connections, sizeof(Conn));
+    Worker* workers = calloc(config.threads, sizeof(Worker));
+
+    // Give connections a moment to be established before the clock starts
+    start_time_ns = now_ns() + 200000000ull;
+    end_time_ns = start_time_ns + (uint64_t)(config.duration * 1e9);
+
+    int offset = 0;
+    for (int i = 0; i < config.threads; i++) {
+        Worker* worker = &workers[i];
+        worker->id = i;
+        worker->num_conns = config.connections / config.threads + (i < config.connections % config.threads);
+        worker->conns = conns + offset;
+        worker->rate = config.rate / config.threads;
+        offset += worker->num_conns;
+        pthread_create(&worker->tid, NULL, worker_loop, worker);
+    }
+
+    Histogram total[CMD_COUNT + 1];
+    uint64_t completed = 0, errors = 0, busy = 0, connect_failures = 0, dropped = 0;
+    memset(total, 0, sizeof total);
+
+    for (int i = 0; i < config.threads; i++) {
+        pthread_join(workers[i].tid, NULL);
+        for (int c = 0; c < CMD_COUNT; c++) {
+            hist_merge(&total[c], &workers[i].hist[c]);
+            hist_merge(&total[CMD_COUNT], &workers[i].hist[c]);
+        }
+        completed += workers[i].completed;
+        errors += workers[i].errors;
+        busy += workers[i].busy;
+        connect_failures += workers[i].connect_failures;
+        dropped += workers[i].dropped;
+    }
+
+    double throughput = completed / config.duration;
+    Histogram* all = &total[CMD_COUNT];
+
+    if (csv) {
+        printf("%.0f,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", throughput,
+               (unsigned long long)hist_percentile(all, 50.0),
+               (unsigned long long)hist_percentile(all, 99.0),
+               (unsigned long long)hist_percentile(all, 99.9),
+               (unsigned long long)all->max,
+               (unsigned long long)(errors + connect_failures),
+               (unsigned long long)completed,
+               (unsigned long long)busy);
+    } else {
+        printf("%d connections, %d threads, %.1fs, %s\n", config.connections, config.threads,
+               config.duration, config.rate > 0 ? "open loop" : "closed loop");
+        printf("%-12s %10s %10s %10s %10s %10s %10s\n",
+               "command", "count", "p50(us)", "p90(us)", "p99(us)", "p99.9(us)", "max(us)");
+        for (int c = 0; c <= CMD_COUNT; c++) {
+            if (total[c].count == 0) continue;
+            printf("%-12s %10llu %10llu %10llu %10llu %10llu %10llu\n",
+                   c < CMD_COUNT ? command_names[c] : "all",
+                   (unsigned long long)total[c].count,
+                   (unsigned long long)hist_percentile(&total[c], 50.0),
+                   (unsigned long long)hist_percentile(&total[c], 90.0),
+                   (unsigned long long)hist_percentile(&total[c], 99.0),
+                   (unsigned long long)hist_percentile(&total[c], 99.9),
+                   (unsigned long long)total[c].max);
+        }
+        printf("throughput: %.0f commands/s, errors: %llu, busy: %llu, connect failures: %llu",
+               throughput, (unsigned long long)errors, (unsigned long long)busy,
+               (unsigned long long)connect_failures);
+        if (config.rate > 0) printf(", sends behind schedule dropped: %llu", (unsigned long long)dropped);
+        printf("\n");
+    }
+
+    free(workers);
+    free(conns);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#!/bin/bash
+# Runs the same loadgen workload against every server architecture and
+# writes a comparison table.
+#
+# Usage: ./shootout.sh [-o output.md] [loadgen options...]
+# Example: ./shootout.sh -o results.md -c 64 -d 20 -m newpoint=50,ch=50
+
+set -u
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+OUTPUT="shootout.md"
+PORT=9034
+
+if [ "${1:-}" = "-o" ]; then
+    OUTPUT="$2"
+    shift 2
+fi
+LOADGEN_ARGS=("$@")
+
+# name|directory|binary
+SERVERS=(
+    "Q4 iterative|Q4|CH_server"
+    "Q6 reactor|Q6|server"
+    "Q7 thread per client|Q7|server"
+    "Q9 proactor|Q9|server"
+    "Q10 proactor + consumer|Q10|server"
+)
+
+wait_for_port() {
+    for _ in $(seq 50); do
+        if (exec 3<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    return 1
+}
+
+make -s -C "$ROOT" >/dev/null || exit 1
+make -s -C "$ROOT/Tools" >/dev/null || exit 1
+
+{
+    echo "Workload: loadgen ${LOADGEN_ARGS[*]:-(defaults)}"
+    echo
+    echo "| Server | Throughput (cmd/s) | p50 (us) | p99 (us) | p99.9 (us) | max (us) | Errors | Completed | Busy |"
+    echo "|---|---:|---:|---:|---:|---:|---:|---:|---:|"
+} > "$OUTPUT"
+
+for entry in "${SERVERS[@]}"; do
+    IFS='|' read -r name dir binary <<< "$entry"
+    echo "Running $name..." >&2
+
+    (cd "$ROOT/$dir" && exec "./$binary" >/dev/null 2>&1) &
+    server_pid=$!
+    if ! wait_for_port; then
+        echo "$name did not start listening on port $PORT" >&2
+        kill "$server_pid" 2>/dev/null
+        wait "$server_pid" 2>/dev/null
+        continue
+    fi
+
+    result=$("$ROOT/Tools/loadgen" -s "${LOADGEN_ARGS[@]}")
+    kill "$server_pid" 2>/dev/null
+    wait "$server_pid" 2>/dev/null
+    # Let the port leave TIME_WAIT bookkeeping before the next server binds
+    sleep 0.5
+
+    IFS=',' read -r tput p50 p99 p999 max errors completed busy <<< "$result"
+    echo "| $name | $tput | $p50 | $p99 | $p999 | $max | $errors | $completed | $busy |" >> "$OUTPUT"
+done
+
+cat "$OUTPUT"